@@ -0,0 +1,48 @@
+#ifndef CANCELLATION
+#define CANCELLATION
+
+#include <atomic>
+#include <memory>
+
+namespace Thread {
+
+// Read side of a cooperative cancellation flag. Tasks poll isCancelled(), a
+// single atomic load, and return early once it is set. A default constructed
+// token is never cancelled.
+class CancellationToken {
+public:
+  CancellationToken() = default;
+
+  bool isCancelled() const {
+    return flag_ != nullptr && flag_->load(std::memory_order_acquire);
+  }
+
+  bool canBeCancelled() const { return flag_ != nullptr; }
+
+private:
+  friend class CancellationSource;
+  explicit CancellationToken(std::shared_ptr<std::atomic<bool>> flag)
+      : flag_{std::move(flag)} {}
+
+  std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+// Owns the flag and hands out tokens that share it.
+class CancellationSource {
+public:
+  CancellationSource() : flag_{std::make_shared<std::atomic<bool>>(false)} {}
+
+  CancellationToken token() const { return CancellationToken(flag_); }
+
+  // Returns false if it was cancelled already.
+  bool cancel() { return !flag_->exchange(true, std::memory_order_acq_rel); }
+
+  bool isCancelled() const { return flag_->load(std::memory_order_acquire); }
+
+private:
+  std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+} // namespace Thread
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef CONCURRENT_CACHE
+#define CONCURRENT_CACHE
+
+#include "reclamation.h"
+#include "thread_safe_container.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace Container {
+
+// Bounded cache on top of ThreadSafeHashMap. Keys are spread over shards, each
+// with its own budget and CLOCK eviction ring. A hit is a lock-free map lookup
+// plus setting the entry's reference bit, so hits never take a write lock;
+// only inserts and evictions take the shard mutex. Evicted entries are retired
+// through EpochReclamation because a reader may still be copying them.
+template <typename Key, typename Value> class ConcurrentCache {
+public:
+  using Clock = std::chrono::steady_clock;
+  // cost of an entry against the budget, every entry costs 1 by default
+  using Weigher = std::function<size_t(Key const &, Value const &)>;
+
+  struct Stats {
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+    uint64_t evictions_{0};
+    uint64_t expirations_{0};
+  };
+
+  ConcurrentCache(size_t capacity, size_t shard_cnt = 16,
+                  Weigher weigher = nullptr)
+      : weigher_{std::move(weigher)} {
+    shard_cnt = std::max<size_t>(shard_cnt, 1);
+    for (size_t i = 0; i < shard_cnt; i++)
+      shards_.emplace_back(new Shard(std::max<size_t>(capacity / shard_cnt, 1)));
+  }
+
+  ~ConcurrentCache() {
+    for (auto &shard : shards_) {
+      for (Entry *entry : shard->ring_)
+        delete entry;
+    }
+  }
+
+  ConcurrentCache(ConcurrentCache const &) = delete;
+  ConcurrentCache &operator=(ConcurrentCache const &) = delete;
+
+  // A ttl of zero never expires.
+  void put(Key const &key, Value const &value,
+           Clock::duration ttl = Clock::duration::zero()) {
+    Shard &shard = shardOf(key);
+    Entry *entry = new Entry(key, value, weigher_ ? weigher_(key, value) : 1,
+                             ttl == Clock::duration::zero()
+                                 ? Clock::time_point::max()
+                                 : Clock::now() + ttl);
+    EpochReclamation::Guard guard;
+    std::unique_lock<std::mutex> lck(shard.mtx_);
+    if (std::optional<Entry *> old = shard.index_.get(key))
+      shard.remove(*old);
+    while (shard.weight_.load(std::memory_order_relaxed) > 0 &&
+           shard.weight_.load(std::memory_order_relaxed) + entry->weight_ >
+               shard.capacity_)
+      shard.evictOne();
+    shard.insert(entry);
+  }
+
+  std::optional<Value> get(Key const &key) {
+    Shard &shard = shardOf(key);
+    EpochReclamation::Guard guard;
+    std::optional<Entry *> found = shard.index_.get(key);
+    if (!found) {
+      shard.misses_.fetch_add(1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+    Entry *entry = *found;
+    if (entry->expired(Clock::now())) {
+      shard.misses_.fetch_add(1, std::memory_order_relaxed);
+      std::unique_lock<std::mutex> lck(shard.mtx_);
+      std::optional<Entry *> current = shard.index_.get(key);
+      if (current && *current == entry) {
+        shard.remove(entry);
+        shard.expirations_.fetch_add(1, std::memory_order_relaxed);
+      }
+      return std::nullopt;
+    }
+    // skip the store when the bit is already set to keep the line shared
+    if (!entry->referenced_.load(std::memory_order_relaxed))
+      entry->referenced_.store(true, std::memory_order_relaxed);
+    shard.hits_.fetch_add(1, std::memory_order_relaxed);
+    return entry->value_;
+  }
+
+  // return true if an entry is erased
+  bool erase(Key const &key) {
+    Shard &shard = shardOf(key);
+    EpochReclamation::Guard guard;
+    std::unique_lock<std::mutex> lck(shard.mtx_);
+    std::optional<Entry *> found = shard.index_.get(key);
+    if (!found)
+      return false;
+    shard.remove(*found);
+    return true;
+  }
+
+  size_t size() const {
+    size_t size = 0;
+    for (auto &shard : shards_)
+      size += shard->index_.size();
+    return size;
+  }
+
+  // total weight of the cached entries
+  size_t weight() const {
+    size_t weight = 0;
+    for (auto &shard : shards_)
+      weight += shard->weight_.load(std::memory_order_relaxed);
+    return weight;
+  }
+
+  size_t shardCount() const { return shards_.size(); }
+
+  // lock-free, the counters may be slightly behind concurrent operations
+  Stats stats(size_t shard) const { return shards_[shard]->stats(); }
+
+  Stats stats() const {
+    Stats total;
+    for (auto &shard : shards_) {
+      Stats stats = shard->stats();
+      total.hits_ += stats.hits_;
+      total.misses_ += stats.misses_;
+      total.evictions_ += stats.evictions_;
+      total.expirations_ += stats.expirations_;
+    }
+    return total;
+  }
+
+private:
+  struct Entry {
+    Entry(Key const &key, Value const &value, size_t weight,
+          Clock::time_point expires)
+        : key_{key}, value_{value}, weight_{weight}, expires_{expires} {}
+    bool expired(Clock::time_point now) const { return now >= expires_; }
+    Key const key_;
+    Value const value_;
+    size_t const weight_;
+    Clock::time_point const expires_;
+    std::atomic<bool> referenced_{false};
+    // position in the CLOCK ring, guarded by the shard mutex
+    size_t slot_{0};
+  };
+
+  struct alignas(kCacheLineSize) Shard {
+    explicit Shard(size_t capacity) : capacity_{capacity} {}
+
+    Stats stats() const {
+      Stats stats;
+      stats.hits_ = hits_.load(std::memory_order_relaxed);
+      stats.misses_ = misses_.load(std::memory_order_relaxed);
+      stats.evictions_ = evictions_.load(std::memory_order_relaxed);
+      stats.expirations_ = expirations_.load(std::memory_order_relaxed);
+      return stats;
+    }
+
+    // the methods below require mtx_
+    void insert(Entry *entry) {
+      if (free_slots_.empty()) {
+        entry->slot_ = ring_.size();
+        ring_.push_back(entry);
+      } else {
+        entry->slot_ = free_slots_.back();
+        free_slots_.pop_back();
+        ring_[entry->slot_] = entry;
+      }
+      weight_.fetch_add(entry->weight_, std::memory_order_relaxed);
+      index_.put(entry->key_, entry);
+    }
+
+    void remove(Entry *entry) {
+      index_.erase(entry->key_);
+      ring_[entry->slot_] = nullptr;
+      free_slots_.push_back(entry->slot_);
+      weight_.fetch_sub(entry->weight_, std::memory_order_relaxed);
+      EpochReclamation::retire(entry);
+    }
+
+    // Advance the hand, giving referenced entries a second chance, and evict
+    // the first expired or unreferenced one.
+    void evictOne() {
+      Clock::time_point now = Clock::now();
+      while (true) {
+        if (hand_ >= ring_.size())
+          hand_ = 0;
+        Entry *entry = ring_[hand_++];
+        if (entry == nullptr)
+          continue;
+        if (entry->expired(now)) {
+          remove(entry);
+          expirations_.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        if (entry->referenced_.load(std::memory_order_relaxed)) {
+          entry->referenced_.store(false, std::memory_order_relaxed);
+          continue;
+        }
+        remove(entry);
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+
+    ThreadSafeHashMap<Key, Entry *> index_;
+    std::mutex mtx_;
+    std::vector<Entry *> ring_;
+    std::vector<size_t> free_slots_;
+    size_t hand_{0};
+    size_t const capacity_;
+    std::atomic<size_t> weight_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> expirations_{0};
+  };
+
+  Shard &shardOf(Key const &key) {
+    return *shards_[detail::mixHash(std::hash<Key>{}(key)) % shards_.size()];
+  }
+
+  Weigher weigher_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace Container
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef COROUTINE
+#define COROUTINE
+
+// Requires C++20.
+#include "future.h"
+#include "timer_wheel.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace Thread {
+
+// Awaiting a future suspends until it is ready and resumes on the thread
+// that completed it.
+template <typename T> auto operator co_await(Future<T> &&future) {
+  struct Awaiter {
+    bool await_ready() { return future_.ready(); }
+    void await_suspend(std::coroutine_handle<> handle) {
+      future_.onReady([this, handle](Future<T> ready) {
+        future_ = std::move(ready);
+        handle.resume();
+      });
+    }
+    T await_resume() { return future_.get(); }
+    Future<T> future_;
+  };
+  return Awaiter{std::move(future)};
+}
+
+template <typename T> auto operator co_await(Future<T> &future) {
+  return operator co_await(std::move(future));
+}
+
+// Thread::Task already names the pools' std::function task type.
+namespace Coro {
+
+// Coroutines on top of the pools. A Task<T> is a lazily started coroutine
+// that resumes whoever awaits it when it finishes. A Scheduler moves
+// coroutines onto a pool:
+//
+//   Task<int> handle(Scheduler<v4::ThreadPoolImpl> &scheduler) {
+//     co_await scheduler.schedule();       // continue on a worker
+//     co_await scheduler.sleepFor(10ms);   // no thread blocks meanwhile
+//     int x = co_await pool.submit(work);  // any Future<T>
+//     co_return x;
+//   }
+//
+// Resumptions go through the pool's execute(), so a worker queues them on
+// its own local queue or deque first.
+template <typename T = void> class Task;
+
+namespace detail {
+
+template <typename T> struct TaskPromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      return handle.promise().continuation_;
+    }
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { exception_ = std::current_exception(); }
+
+  std::coroutine_handle<> continuation_{std::noop_coroutine()};
+  std::exception_ptr exception_;
+};
+
+template <typename T> struct TaskPromise : TaskPromiseBase<T> {
+  Task<T> get_return_object();
+
+  template <typename U> void return_value(U &&value) {
+    value_.emplace(std::forward<U>(value));
+  }
+
+  T result() {
+    if (this->exception_)
+      std::rethrow_exception(this->exception_);
+    return std::move(*value_);
+  }
+
+  std::optional<T> value_;
+};
+
+template <> struct TaskPromise<void> : TaskPromiseBase<void> {
+  Task<void> get_return_object();
+
+  void return_void() {}
+
+  void result() {
+    if (exception_)
+      std::rethrow_exception(exception_);
+  }
+};
+
+// Fire-and-forget coroutine, its frame frees itself when it finishes.
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+template <typename T> Detached start(Task<T> task, Promise<T> promise) {
+  try {
+    if constexpr (std::is_void<T>::value) {
+      co_await std::move(task);
+      promise.set_value();
+    } else {
+      promise.set_value(co_await std::move(task));
+    }
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+}
+
+} // namespace detail
+
+template <typename T> class Task {
+public:
+  using promise_type = detail::TaskPromise<T>;
+
+  Task(Task &&other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  Task(Task const &) = delete;
+  Task &operator=(Task const &) = delete;
+  ~Task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  // Start the task and suspend the awaiting coroutine until it finishes.
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      bool await_ready() noexcept { return handle_.done(); }
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle_.promise().continuation_ = continuation;
+        return handle_;
+      }
+      T await_resume() { return handle_.promise().result(); }
+      std::coroutine_handle<promise_type> handle_;
+    };
+    return Awaiter{handle_};
+  }
+
+private:
+  friend promise_type;
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_{handle} {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <typename T> Task<T> TaskPromise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+  return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+// Run task on the calling thread until it first suspends and return a future
+// of its result.
+template <typename T> Future<T> spawn(Task<T> task) {
+  Promise<T> promise;
+  Future<T> result = promise.get_future();
+  detail::start(std::move(task), std::move(promise));
+  return result;
+}
+
+// Block the calling thread until task finishes, for use outside the pool.
+template <typename T> T syncWait(Task<T> task) {
+  return spawn(std::move(task)).get();
+}
+
+// Resumes coroutines on Pool, anything with bool execute(Function &&), and
+// drives timed waits with a TimerWheel. Coroutines still sleeping when the
+// scheduler is destroyed are never resumed.
+template <typename Pool> class Scheduler {
+public:
+  using Clock = TimerWheel::Clock;
+
+  explicit Scheduler(Pool &pool,
+                     Clock::duration tick = std::chrono::milliseconds(1))
+      : pool_{pool}, timers_{tick} {}
+
+  // Continue the awaiting coroutine on a pool worker.
+  auto schedule() {
+    struct Awaiter {
+      bool await_ready() noexcept { return false; }
+      bool await_suspend(std::coroutine_handle<> handle) {
+        // resume right here if the pool does not take the task
+        return pool_.execute(InplaceFunction<64>([handle]() { handle.resume(); }));
+      }
+      void await_resume() noexcept {}
+      Pool &pool_;
+    };
+    return Awaiter{pool_};
+  }
+
+  // Suspend without holding a thread and continue on a pool worker.
+  auto sleepUntil(Clock::time_point deadline) {
+    struct Awaiter {
+      bool await_ready() { return Clock::now() >= deadline_; }
+      bool await_suspend(std::coroutine_handle<> handle) {
+        Pool *pool = &scheduler_.pool_;
+        return scheduler_.timers_
+            .schedule(deadline_,
+                      [pool, handle]() {
+                        if (!pool->execute(InplaceFunction<64>(
+                                [handle]() { handle.resume(); })))
+                          handle.resume();
+                      })
+            .valid();
+      }
+      void await_resume() noexcept {}
+      Scheduler &scheduler_;
+      Clock::time_point deadline_;
+    };
+    return Awaiter{*this, deadline};
+  }
+
+  auto sleepFor(Clock::duration delay) { return sleepUntil(Clock::now() + delay); }
+
+  // Start task on a pool worker and return a future of its result.
+  template <typename T> Future<T> spawn(Task<T> task) {
+    return Coro::spawn(onPool(std::move(task)));
+  }
+
+private:
+  template <typename T> Task<T> onPool(Task<T> task) {
+    co_await schedule();
+    if constexpr (std::is_void<T>::value)
+      co_await std::move(task);
+    else
+      co_return co_await std::move(task);
+  }
+
+  Pool &pool_;
+  TimerWheel timers_;
+};
+
+} // namespace Coro
+} // namespace Thread
+
+#endif
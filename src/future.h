@@ -0,0 +1,469 @@
+#ifndef FUTURE
+#define FUTURE
+
+#include "inplace_function.h"
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Thread {
+
+// Pool-native future and promise. The shared state is recycled through a
+// per-thread slab and completes through one atomic word, so a task that
+// finishes with nobody waiting touches no mutex or condvar. Continuations
+// attached with then() are handed to an executor, anything with
+//
+//   bool execute(InplaceFunction<64> &&task);  // leaves task alone if rejected
+//
+// such as the v3 and v4 pools, or run on the completing thread if it has none.
+template <typename T> class Future;
+template <typename T> class Promise;
+
+namespace detail {
+
+using Callback = InplaceFunction<64>;
+
+struct Unit {};
+
+// Per-thread cache of BlockSize blocks. Freed blocks go to the cache of the
+// freeing thread and are handed back to the allocator when it exits.
+template <size_t BlockSize> class Slab {
+  struct FreeBlock {
+    FreeBlock *next_;
+  };
+
+  struct Cache {
+    ~Cache() {
+      while (head_ != nullptr) {
+        FreeBlock *next = head_->next_;
+        ::operator delete(head_);
+        head_ = next;
+      }
+    }
+    FreeBlock *head_{nullptr};
+    size_t size_{0};
+  };
+
+public:
+  static void *allocate() {
+    Cache &cache = local();
+    FreeBlock *block = cache.head_;
+    if (block == nullptr)
+      return ::operator new(BlockSize);
+    cache.head_ = block->next_;
+    cache.size_--;
+    return block;
+  }
+
+  static void deallocate(void *ptr) {
+    Cache &cache = local();
+    if (cache.size_ >= kMaxCached) {
+      ::operator delete(ptr);
+      return;
+    }
+    FreeBlock *block = static_cast<FreeBlock *>(ptr);
+    block->next_ = cache.head_;
+    cache.head_ = block;
+    cache.size_++;
+  }
+
+private:
+  static constexpr size_t kMaxCached = 1024;
+
+  static Cache &local() {
+    thread_local Cache cache;
+    return cache;
+  }
+};
+
+template <typename T> class SharedState {
+public:
+  using Value = std::conditional_t<std::is_void<T>::value, Unit, T>;
+
+  static void *operator new(size_t size) {
+    if (size <= 128)
+      return Slab<128>::allocate();
+    if (size <= 256)
+      return Slab<256>::allocate();
+    return ::operator new(size);
+  }
+
+  static void operator delete(void *ptr, size_t size) {
+    if (size <= 128)
+      Slab<128>::deallocate(ptr);
+    else if (size <= 256)
+      Slab<256>::deallocate(ptr);
+    else
+      ::operator delete(ptr);
+  }
+
+  ~SharedState() {
+    if (value_)
+      value_->~Value();
+  }
+
+  void addRef() { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+  void release() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+
+  bool ready() const { return state_.load(std::memory_order_acquire) == kReady; }
+
+  template <typename... Args> void setValue(Args &&...args) {
+    value_ = ::new (static_cast<void *>(&storage_))
+        Value(std::forward<Args>(args)...);
+    complete();
+  }
+
+  void setException(std::exception_ptr exception) {
+    exception_ = std::move(exception);
+    complete();
+  }
+
+  // only valid once ready() is true
+  Value &value() { return *value_; }
+  std::exception_ptr const &exception() const { return exception_; }
+
+  // Run callback once the state is ready, through executor if it is not
+  // null. A state holds a single callback.
+  template <typename Executor>
+  void onReady(Callback &&callback, Executor *executor) {
+    callback_ = std::move(callback);
+    if (executor != nullptr) {
+      executor_ = executor;
+      schedule_ = [](void *executor, Callback &callback) {
+        return static_cast<Executor *>(executor)->execute(std::move(callback));
+      };
+    }
+    uint32_t expected = kPending;
+    if (!state_.compare_exchange_strong(expected, kCallback,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire))
+      dispatch();
+  }
+
+private:
+  static constexpr uint32_t kPending = 0;
+  static constexpr uint32_t kCallback = 1;
+  static constexpr uint32_t kReady = 2;
+
+  void complete() {
+    if (state_.exchange(kReady, std::memory_order_acq_rel) == kCallback)
+      dispatch();
+  }
+
+  void dispatch() {
+    // the callback may own the last reference to this state, move it out
+    Callback callback = std::move(callback_);
+    if (schedule_ != nullptr && schedule_(executor_, callback))
+      return;
+    callback();
+  }
+
+  // kPending -> kCallback when a callback is attached, -> kReady on completion
+  std::atomic<uint32_t> state_{kPending};
+  std::atomic<uint32_t> refs_{1};
+  Value *value_{nullptr};
+  std::exception_ptr exception_;
+  Callback callback_;
+  void *executor_{nullptr};
+  bool (*schedule_)(void *, Callback &){nullptr};
+  alignas(Value) unsigned char storage_[sizeof(Value)];
+};
+
+// Run f and store its result or exception in promise.
+template <typename R, typename F> void fulfil(Promise<R> &promise, F &f) {
+  try {
+    if constexpr (std::is_void<R>::value) {
+      f();
+      promise.set_value();
+    } else {
+      promise.set_value(f());
+    }
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+}
+
+struct NoExecutor {
+  bool execute(Callback &&) { return false; }
+};
+
+} // namespace detail
+
+template <typename T> class Future {
+  template <typename U> friend class Future;
+  friend class Promise<T>;
+
+public:
+  Future() = default;
+  Future(Future &&other) noexcept : state_{other.state_} {
+    other.state_ = nullptr;
+  }
+  Future &operator=(Future &&other) noexcept {
+    if (this != &other) {
+      if (state_ != nullptr)
+        state_->release();
+      state_ = other.state_;
+      other.state_ = nullptr;
+    }
+    return *this;
+  }
+  Future(Future const &) = delete;
+  Future &operator=(Future const &) = delete;
+  ~Future() {
+    if (state_ != nullptr)
+      state_->release();
+  }
+
+  bool valid() const { return state_ != nullptr; }
+
+  bool ready() const { return state_ != nullptr && state_->ready(); }
+
+  // Blocks the calling thread; pool workers should use the pool's
+  // waitUntilReady() or then() instead.
+  void wait() {
+    assert(valid());
+    if (state_->ready())
+      return;
+    struct Waiter {
+      std::mutex mtx_;
+      std::condition_variable cv_;
+      bool done_{false};
+    } waiter;
+    state_->onReady(detail::Callback([&waiter]() {
+                      std::lock_guard<std::mutex> lck(waiter.mtx_);
+                      waiter.done_ = true;
+                      waiter.cv_.notify_one();
+                    }),
+                    static_cast<detail::NoExecutor *>(nullptr));
+    std::unique_lock<std::mutex> lck(waiter.mtx_);
+    waiter.cv_.wait(lck, [&waiter] { return waiter.done_; });
+  }
+
+  // Wait for the result and move it out, rethrows a stored exception. The
+  // future is invalid afterwards.
+  T get() {
+    wait();
+    Future self(std::move(*this));
+    if (self.state_->exception())
+      std::rethrow_exception(self.state_->exception());
+    if constexpr (!std::is_void<T>::value)
+      return std::move(self.state_->value());
+  }
+
+  // Call f(Future<T>&&) with the ready future on the completing thread, or
+  // right away if it is ready already. Consumes the future.
+  template <typename F> void onReady(F &&f) {
+    attach(static_cast<detail::NoExecutor *>(nullptr), std::forward<F>(f));
+  }
+
+  // Same as above, but f runs as a task of executor.
+  template <typename Executor, typename F>
+  void onReady(Executor &executor, F &&f) {
+    attach(&executor, std::forward<F>(f));
+  }
+
+  // Run f with the value once it is ready and return a future of its result.
+  // An exception skips f and is passed on to the returned future.
+  template <typename Executor, typename F> auto then(Executor &executor, F &&f) {
+    return chain(&executor, std::forward<F>(f));
+  }
+
+  template <typename F> auto then(F &&f) {
+    return chain(static_cast<detail::NoExecutor *>(nullptr), std::forward<F>(f));
+  }
+
+private:
+  explicit Future(detail::SharedState<T> *state) : state_{state} {}
+
+  template <typename Executor, typename F>
+  void attach(Executor *executor, F &&f) {
+    assert(valid());
+    detail::SharedState<T> *state = state_;
+    state->onReady(detail::Callback([self = std::move(*this),
+                                     f = std::forward<F>(f)]() mutable {
+                     f(std::move(self));
+                   }),
+                   executor);
+  }
+
+  template <typename Executor, typename F> auto chain(Executor *executor, F &&f) {
+    using R = typename std::conditional_t<
+        std::is_void<T>::value, std::invoke_result<std::decay_t<F> &>,
+        std::invoke_result<std::decay_t<F> &, T &&>>::type;
+    Promise<R> promise;
+    Future<R> result = promise.get_future();
+    attach(executor, [promise = std::move(promise),
+                       f = std::forward<F>(f)](Future self) mutable {
+      if (self.state_->exception()) {
+        promise.set_exception(self.state_->exception());
+        return;
+      }
+      auto call = [&]() -> R {
+        if constexpr (std::is_void<T>::value)
+          return f();
+        else
+          return f(std::move(self.state_->value()));
+      };
+      detail::fulfil(promise, call);
+    });
+    return result;
+  }
+
+  detail::SharedState<T> *state_{nullptr};
+};
+
+template <typename T> class Promise {
+public:
+  Promise() : state_{new detail::SharedState<T>()} {}
+  Promise(Promise &&other) noexcept
+      : state_{other.state_}, satisfied_{other.satisfied_} {
+    other.state_ = nullptr;
+  }
+  Promise &operator=(Promise &&other) noexcept {
+    if (this != &other) {
+      abandon();
+      state_ = other.state_;
+      satisfied_ = other.satisfied_;
+      other.state_ = nullptr;
+    }
+    return *this;
+  }
+  Promise(Promise const &) = delete;
+  Promise &operator=(Promise const &) = delete;
+  // a promise dropped without a result breaks its future
+  ~Promise() { abandon(); }
+
+  // may be called once
+  Future<T> get_future() {
+    state_->addRef();
+    return Future<T>(state_);
+  }
+
+  template <typename... Args> void set_value(Args &&...args) {
+    assert(!satisfied_);
+    satisfied_ = true;
+    state_->setValue(std::forward<Args>(args)...);
+  }
+
+  void set_exception(std::exception_ptr exception) {
+    assert(!satisfied_);
+    satisfied_ = true;
+    state_->setException(std::move(exception));
+  }
+
+private:
+  void abandon() {
+    if (state_ == nullptr)
+      return;
+    if (!satisfied_)
+      state_->setException(std::make_exception_ptr(
+          std::future_error(std::future_errc::broken_promise)));
+    state_->release();
+    state_ = nullptr;
+  }
+
+  detail::SharedState<T> *state_;
+  bool satisfied_{false};
+};
+
+// Becomes ready once every future is. Holds the values in input order, or
+// the first exception if any future failed.
+template <typename T>
+auto when_all(std::vector<Future<T>> futures) {
+  using Result =
+      std::conditional_t<std::is_void<T>::value, void, std::vector<T>>;
+  using Slot = std::conditional_t<std::is_void<T>::value, detail::Unit,
+                                  std::optional<T>>;
+  struct Context {
+    explicit Context(size_t n) : pending_{n}, values_(n) {}
+    std::atomic<size_t> pending_;
+    std::vector<Slot> values_;
+    std::atomic<bool> failed_{false};
+    std::exception_ptr exception_;
+    Promise<Result> promise_;
+
+    void finish() {
+      if (failed_.load(std::memory_order_relaxed)) {
+        promise_.set_exception(exception_);
+      } else if constexpr (std::is_void<T>::value) {
+        promise_.set_value();
+      } else {
+        std::vector<T> values;
+        values.reserve(values_.size());
+        for (auto &value : values_)
+          values.push_back(std::move(*value));
+        promise_.set_value(std::move(values));
+      }
+    }
+  };
+  auto context = std::make_shared<Context>(futures.size());
+  Future<Result> result = context->promise_.get_future();
+  if (futures.empty()) {
+    context->finish();
+    return result;
+  }
+  for (size_t i = 0; i < futures.size(); i++) {
+    futures[i].onReady([context, i](Future<T> future) {
+      try {
+        if constexpr (std::is_void<T>::value)
+          future.get();
+        else
+          context->values_[i].emplace(future.get());
+      } catch (...) {
+        if (!context->failed_.exchange(true, std::memory_order_relaxed))
+          context->exception_ = std::current_exception();
+      }
+      if (context->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        context->finish();
+    });
+  }
+  return result;
+}
+
+// Becomes ready with the index (and value) of the first future to complete,
+// or its exception. futures must not be empty.
+template <typename T>
+auto when_any(std::vector<Future<T>> futures) {
+  using Result = std::conditional_t<std::is_void<T>::value, size_t,
+                                    std::pair<size_t, T>>;
+  struct Context {
+    std::atomic<bool> done_{false};
+    Promise<Result> promise_;
+  };
+  auto context = std::make_shared<Context>();
+  Future<Result> result = context->promise_.get_future();
+  for (size_t i = 0; i < futures.size(); i++) {
+    futures[i].onReady([context, i](Future<T> future) {
+      if (context->done_.exchange(true, std::memory_order_relaxed))
+        return;
+      try {
+        if constexpr (std::is_void<T>::value) {
+          future.get();
+          context->promise_.set_value(i);
+        } else {
+          context->promise_.set_value(i, future.get());
+        }
+      } catch (...) {
+        context->promise_.set_exception(std::current_exception());
+      }
+    });
+  }
+  return result;
+}
+
+} // namespace Thread
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef INPLACE_FUNCTION
+#define INPLACE_FUNCTION
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Thread {
+
+// Move-only void() callable with Size bytes of inline storage. Callables that
+// fit and are nothrow movable are constructed in place; bigger ones fall back
+// to a single heap allocation. Dispatch goes through a static per-type table
+// of function pointers instead of a virtual base, so an empty or inline
+// function costs no allocation at all.
+template <size_t Size> class InplaceFunction {
+  struct Ops {
+    void (*invoke_)(void *);
+    // move constructs into dst and destroys src
+    void (*relocate_)(void *dst, void *src);
+    void (*destroy_)(void *);
+    bool inline_;
+  };
+
+  template <typename F> static constexpr bool fitsInline() {
+    return sizeof(F) <= Size && alignof(F) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible<F>::value;
+  }
+
+  template <typename F> struct InlineOps {
+    static F *get(void *storage) {
+      return std::launder(reinterpret_cast<F *>(storage));
+    }
+    static void invoke(void *storage) { (*get(storage))(); }
+    static void relocate(void *dst, void *src) {
+      ::new (dst) F(std::move(*get(src)));
+      get(src)->~F();
+    }
+    static void destroy(void *storage) { get(storage)->~F(); }
+    static constexpr Ops kOps{&invoke, &relocate, &destroy, true};
+  };
+
+  template <typename F> struct HeapOps {
+    static F *&get(void *storage) { return *reinterpret_cast<F **>(storage); }
+    static void invoke(void *storage) { (*get(storage))(); }
+    static void relocate(void *dst, void *src) {
+      ::new (dst) F *(get(src));
+    }
+    static void destroy(void *storage) { delete get(storage); }
+    static constexpr Ops kOps{&invoke, &relocate, &destroy, false};
+  };
+
+public:
+  static constexpr size_t kCapacity = Size;
+
+  InplaceFunction() = default;
+
+  template <typename F, typename D = std::decay_t<F>,
+            typename = std::enable_if_t<
+                !std::is_same<D, InplaceFunction>::value>>
+  InplaceFunction(F &&f) {
+    static_assert(Size >= sizeof(void *), "storage must hold a pointer");
+    if constexpr (fitsInline<D>()) {
+      ::new (static_cast<void *>(storage_)) D(std::forward<F>(f));
+      ops_ = &InlineOps<D>::kOps;
+    } else {
+      ::new (static_cast<void *>(storage_)) D *(new D(std::forward<F>(f)));
+      ops_ = &HeapOps<D>::kOps;
+    }
+  }
+
+  InplaceFunction(InplaceFunction &&other) noexcept : ops_{other.ops_} {
+    if (ops_ != nullptr) {
+      ops_->relocate_(storage_, other.storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  InplaceFunction &operator=(InplaceFunction &&other) noexcept {
+    if (this != &other) {
+      reset();
+      if (other.ops_ != nullptr) {
+        other.ops_->relocate_(storage_, other.storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  InplaceFunction(InplaceFunction const &) = delete;
+  InplaceFunction &operator=(InplaceFunction const &) = delete;
+
+  ~InplaceFunction() { reset(); }
+
+  void operator()() { ops_->invoke_(storage_); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  // true if the callable lives in the inline storage
+  bool isInline() const { return ops_ != nullptr && ops_->inline_; }
+
+private:
+  void reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy_(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  Ops const *ops_{nullptr};
+  alignas(std::max_align_t) unsigned char storage_[Size];
+};
+
+} // namespace Thread
+
+#endif
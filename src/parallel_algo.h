@@ -1,50 +1,689 @@
 #ifndef PARALLEL_ALGO
 #define PARALLEL_ALGO
 
+#include "simd.h"
+#include "thread_pool.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <functional>
 #include <future>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <type_traits>
+#include <thread>
+#include <tuple>
 #include <vector>
 #include <list>
 
 namespace Parallel {
 
+namespace detail {
+
+// ranges up to this size are sorted sequentially with std::sort
+constexpr std::ptrdiff_t kSortCutoff = 2048;
+
+// Per-thread pivot generator, unlike rand() it takes no global lock.
+inline std::minstd_rand &randomEngine() {
+  static thread_local std::minstd_rand engine(static_cast<std::minstd_rand::result_type>(
+      std::hash<std::thread::id>()(std::this_thread::get_id()) | 1));
+  return engine;
+}
+
+inline std::ptrdiff_t randomIndex(std::ptrdiff_t n) {
+  return std::uniform_int_distribution<std::ptrdiff_t>(0, n - 1)(randomEngine());
+}
+
+// worker count of pool, the hardware's for pools that do not report one
+template <typename Pool>
+auto poolThreads(Pool const &pool, int) -> decltype(static_cast<size_t>(pool.threads())) {
+  return pool.threads();
+}
+
+template <typename Pool> size_t poolThreads(Pool const &, long) {
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Median of three random elements, copied since partitioning moves them.
+template <typename RandomIt>
+typename std::iterator_traits<RandomIt>::value_type pickPivot(RandomIt first, RandomIt last) {
+  std::ptrdiff_t n = last - first;
+  auto const &a = first[randomIndex(n)];
+  auto const &b = first[randomIndex(n)];
+  auto const &c = first[randomIndex(n)];
+  if (a < b)
+    return b < c ? b : (a < c ? c : a);
+  return a < c ? a : (b < c ? c : b);
+}
+
+// Run left on pool and right on the calling thread, return when both are
+// done. A worker waiting for left keeps running other tasks, and the pool's
+// idle workers have to be able to steal left from it, as v3 and v4 workers
+// do, or the recursion stays on one thread. If either throws, the exception
+// reaches the caller after both have finished.
+template <typename Pool, typename F, typename G>
+void forkJoin(Pool &pool, F const &left, G const &right) {
+  Thread::Future<void> future = pool.submit([&left]() { left(); });
+  // run it here if the pool did not take it
+  if (!future.valid()) {
+    left();
+    right();
+    return;
+  }
+  std::exception_ptr error;
+  try {
+    right();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  pool.waitUntilReady(future);
+  try {
+    future.get();
+  } catch (...) {
+    if (!error)
+      error = std::current_exception();
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// Iterators over contiguous int32_t, float or double, whose ranges the
+// Simd kernels can take.
+template <typename It, typename T = typename std::iterator_traits<It>::value_type>
+constexpr bool kSimdRange = Simd::kVectorizable<T> &&
+                            (std::is_same<It, T *>::value || std::is_same<It, T const *>::value ||
+                             std::is_same<It, typename std::vector<T>::iterator>::value ||
+                             std::is_same<It, typename std::vector<T>::const_iterator>::value);
+
+template <typename Op, typename T>
+constexpr bool kPlus = std::is_same<Op, std::plus<>>::value || std::is_same<Op, std::plus<T>>::value;
+
+// Split [first, last) into x < pivot, x == pivot and the rest. Simd ranges of
+// up to Simd::detail::kScratchMax elements use the branch free vector
+// partition, which stages elements in a buffer each thread keeps at that
+// size; longer ones, the top few levels of a big sort, partition in place so
+// sorting never takes memory in proportion to the range. x == pivot is
+// x < the next value up.
+template <typename RandomIt, typename T>
+std::pair<RandomIt, RandomIt> partition3(RandomIt first, RandomIt last, T const &pivot) {
+  if constexpr (kSimdRange<RandomIt>) {
+    if (static_cast<size_t>(last - first) <= Simd::detail::kScratchMax) {
+      RandomIt mid1 = first + Simd::partition(&*first, last - first, pivot);
+      T above;
+      if constexpr (std::is_integral<T>::value) {
+        if (pivot == std::numeric_limits<T>::max())
+          return {mid1, last};
+        above = pivot + 1;
+      } else {
+        if (pivot == std::numeric_limits<T>::infinity())
+          return {mid1, last};
+        above = std::nextafter(pivot, std::numeric_limits<T>::infinity());
+      }
+      return {mid1, mid1 + Simd::partition(&*mid1, last - mid1, above)};
+    }
+  }
+  RandomIt mid1 = std::partition(first, last, [&](T const &t) { return t < pivot; });
+  RandomIt mid2 = std::partition(mid1, last, [&](T const &t) { return !(pivot < t); });
+  return {mid1, mid2};
+}
+
+// Quicksort that hands the left part of every partition to the pool and
+// keeps the right part, so workers steal the big chunks first. The three way
+// partition keeps duplicates out of both halves; after depth levels the range
+// goes to std::sort, which bounds the worst case like introsort does.
+template <typename Pool, typename RandomIt>
+void sortRange(Pool &pool, RandomIt first, RandomIt last, int depth) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  if (last - first <= kSortCutoff || depth == 0) {
+    std::sort(first, last);
+    return;
+  }
+  T pivot = pickPivot(first, last);
+  RandomIt mid1, mid2;
+  std::tie(mid1, mid2) = partition3(first, last, pivot);
+  forkJoin(pool, [&]() { sortRange(pool, first, mid1, depth - 1); },
+           [&]() { sortRange(pool, mid2, last, depth - 1); });
+}
+
+// 2 * log2(n), the depth std::sort allows before it switches to heapsort
+inline int depthLimit(std::ptrdiff_t n) {
+  int depth = 0;
+  for (; n > 1; n >>= 1)
+    depth += 2;
+  return depth;
+}
+
+// shared by the overloads without a pool, started on first use
+inline Thread::v4::ThreadPoolImpl &defaultPool() {
+  static Thread::v4::ThreadPoolImpl pool(std::max(std::thread::hardware_concurrency(), 1u));
+  static bool started = pool.start();
+  (void)started;
+  return pool;
+}
+
+// Run f(i) for i in [first, last) on pool and return when all are done. The
+// range is split in halves until single indices are left, so idle workers
+// steal the biggest pieces first.
+template <typename Pool, typename F>
+void forEachIndex(Pool &pool, size_t first, size_t last, F const &f) {
+  if (last - first == 1) {
+    f(first);
+    return;
+  }
+  if (last == first)
+    return;
+  size_t mid = first + (last - first) / 2;
+  forkJoin(pool, [&]() { forEachIndex(pool, first, mid, f); },
+           [&]() { forEachIndex(pool, mid, last, f); });
+}
+
+template <typename Pool, typename F> void forEachIndex(Pool &pool, size_t n, F const &f) {
+  forEachIndex(pool, 0, n, f);
+}
+
+// fewer elements are sorted with std::stable_sort
+constexpr size_t kRadixCutoff = 1024;
+// smallest block a task histograms and scatters
+constexpr size_t kRadixMinBlock = 16384;
+// Scatter stages this many bytes per bucket and writes them out together,
+// so the 256 output streams touch one cache line, and one TLB entry, at a
+// time instead of one per element.
+constexpr size_t kRadixBufferBytes = 256;
+
+template <typename Key> auto radixKey(Key key) {
+  using Unsigned = std::make_unsigned_t<Key>;
+  Unsigned bits = static_cast<Unsigned>(key);
+  // flip the sign bit so negative keys order before positive ones
+  if (std::is_signed<Key>::value)
+    bits ^= Unsigned(1) << (sizeof(Key) * 8 - 1);
+  return bits;
+}
+
+// LSD radix sort of arr by key(element), one byte per pass. Every pass
+// histograms the blocks in parallel, turns the counts into per block
+// offsets and scatters the blocks in parallel. Passes where every element
+// has the same byte are skipped.
+template <typename Pool, typename T, typename KeyFn>
+void radixSort(Pool &pool, std::vector<T> &arr, KeyFn key) {
+  using Key = std::decay_t<decltype(key(arr[0]))>;
+  static_assert(std::is_integral<Key>::value, "radix keys must be integers");
+  constexpr size_t kBuckets = 256;
+  constexpr size_t kStage = kRadixBufferBytes / sizeof(T);
+  size_t n = arr.size();
+  if (n < kRadixCutoff) {
+    std::stable_sort(arr.begin(), arr.end(), [&](T const &a, T const &b) {
+      return radixKey(key(a)) < radixKey(key(b));
+    });
+    return;
+  }
+  size_t blocks = std::max<size_t>(
+      1, std::min<size_t>(std::max<size_t>(poolThreads(pool, 0), 1) * 4, n / kRadixMinBlock));
+  size_t block_size = (n + blocks - 1) / blocks;
+  std::vector<T> buffer(n);
+  T *src = arr.data();
+  T *dst = buffer.data();
+  std::vector<std::array<size_t, kBuckets>> offsets(blocks);
+  for (unsigned shift = 0; shift < sizeof(Key) * 8; shift += 8) {
+    auto digit = [&](T const &t) { return (radixKey(key(t)) >> shift) & 0xff; };
+    forEachIndex(pool, blocks, [&](size_t b) {
+      auto &count = offsets[b];
+      count.fill(0);
+      for (size_t i = b * block_size; i < std::min(n, (b + 1) * block_size); i++)
+        count[digit(src[i])]++;
+    });
+    bool skip = false;
+    size_t sum = 0;
+    for (size_t d = 0; d < kBuckets; d++) {
+      size_t total = 0;
+      for (size_t b = 0; b < blocks; b++) {
+        size_t count = offsets[b][d];
+        offsets[b][d] = sum + total;
+        total += count;
+      }
+      skip = skip || total == n;
+      sum += total;
+    }
+    if (skip)
+      continue;
+    forEachIndex(pool, blocks, [&](size_t b) {
+      auto &offset = offsets[b];
+      size_t first = b * block_size;
+      size_t last = std::min(n, first + block_size);
+      if constexpr (kStage >= 2) {
+        std::vector<T> stage(kBuckets * kStage);
+        std::array<size_t, kBuckets> fill{};
+        for (size_t i = first; i < last; i++) {
+          size_t d = digit(src[i]);
+          stage[d * kStage + fill[d]] = std::move(src[i]);
+          if (++fill[d] == kStage) {
+            std::move(&stage[d * kStage], &stage[d * kStage] + kStage, dst + offset[d]);
+            offset[d] += kStage;
+            fill[d] = 0;
+          }
+        }
+        for (size_t d = 0; d < kBuckets; d++)
+          std::move(&stage[d * kStage], &stage[d * kStage] + fill[d], dst + offset[d]);
+      } else {
+        for (size_t i = first; i < last; i++)
+          dst[offset[digit(src[i])]++] = std::move(src[i]);
+      }
+    });
+    std::swap(src, dst);
+  }
+  if (src != arr.data())
+    arr.swap(buffer);
+}
+
+// smallest slice a MergeRuns task merges
+constexpr size_t kMergeMinSlice = 16384;
+// shorter lists are sorted with std::list::sort
+constexpr size_t kListCutoff = 4096;
+
+template <typename Pool, typename T>
+void sortList(Pool &pool, std::list<T> &list, int depth) {
+  size_t n = list.size();
+  if (n <= kListCutoff || depth <= 0) {
+    list.sort();
+    return;
+  }
+  std::list<T> right;
+  right.splice(right.begin(), list, std::next(list.begin(), n / 2), list.end());
+  forkJoin(pool, [&]() { sortList(pool, list, depth - 1); },
+           [&]() { sortList(pool, right, depth - 1); });
+  list.merge(right);
+}
+
+// smallest chunk the algorithms below make unless told otherwise
+constexpr size_t kDefaultGrain = 1024;
+
+// Splits of n elements the algorithms below make: up to eight per pool
+// thread so stealing can even out uneven chunks, none below grain elements.
+// A range shorter than two grains is a single chunk and runs inline.
+template <typename Pool> size_t chunkCount(Pool const &pool, size_t n, size_t grain) {
+  if (n == 0)
+    return 0;
+  size_t chunks = std::min(n / std::max<size_t>(grain, 1),
+                           std::max<size_t>(poolThreads(pool, 0), 1) * 8);
+  return std::max<size_t>(chunks, 1);
+}
+
+// Run body(chunk, first, last) on every chunk of [first, first + n).
+template <typename Pool, typename RandomIt, typename Body>
+void forEachChunk(Pool &pool, RandomIt first, size_t n, size_t chunks, Body const &body) {
+  forEachIndex(pool, chunks, [&](size_t c) {
+    body(c, first + c * n / chunks, first + (c + 1) * n / chunks);
+  });
+}
+
+} // namespace detail
+
 template <typename T> int Partition(std::vector<T> &arr, int start, int end) {
-  std::swap(arr[end], arr[start + rand() % (end - start)]);
-  T const &pivot = arr[end];
-  int j = start - 1;
-  for (int i = start; i <= end; i++) {
-    if (arr[i] < pivot) {
-      std::swap(arr[++j], arr[i]);
+  if (end <= start)
+    return start;
+  std::swap(arr[end], arr[start + detail::randomIndex(end - start)]);
+  if constexpr (Simd::kVectorizable<T>) {
+    // branch free and stable, a vector compare per several elements
+    int j = start + static_cast<int>(Simd::partition(&arr[start], end - start, arr[end]));
+    std::swap(arr[j], arr[end]);
+    return j;
+  } else {
+    T const &pivot = arr[end];
+    int j = start - 1;
+    for (int i = start; i <= end; i++) {
+      if (arr[i] < pivot) {
+        std::swap(arr[++j], arr[i]);
+      }
     }
+    std::swap(arr[j + 1], arr[end]);
+    return j + 1;
   }
-  std::swap(arr[j + 1], arr[end]);
-  return j + 1;
 }
 
-template <typename T> void SortVector(std::vector<T> &arr, int start, int end) {
+// Sort arr[start..end] on pool, anything with submit() and waitUntilReady()
+// whose workers steal each other's tasks, such as v3 or v4 pools. Returns
+// once the range is sorted; exceptions from comparisons reach the caller.
+// int32_t, float and double ranges are partitioned with vector kernels once
+// they are short enough to stage in a small per thread buffer, see
+// partition3.
+template <typename T, typename Pool>
+void SortVector(Pool &pool, std::vector<T> &arr, int start, int end) {
   if (end - start < 1)
     return;
-  int pivot_idx = Partition(arr, start, end);
-  auto handle1 = std::async(&SortVector<T>, std::ref(arr), start, pivot_idx - 1);
-  auto handle2 = std::async(&SortVector<T>, std::ref(arr), pivot_idx + 1, end);
+  auto first = arr.begin() + start;
+  auto last = arr.begin() + end + 1;
+  detail::sortRange(pool, first, last, detail::depthLimit(last - first));
+}
+
+// Sort arr[start..end] on a process wide work stealing pool.
+template <typename T> void SortVector(std::vector<T> &arr, int start, int end) {
+  SortVector(detail::defaultPool(), arr, start, end);
+}
+
+// Sort integers on pool with a parallel LSD radix sort, T must be integral.
+template <typename T, typename Pool> void RadixSort(Pool &pool, std::vector<T> &arr) {
+  detail::radixSort(pool, arr, [](T const &t) { return t; });
+}
+
+// Stable sort of arr by an integer key, e.g. [](Event const &e) { return e.time_; }.
+// T must be default constructible.
+template <typename T, typename Pool, typename KeyFn>
+void RadixSort(Pool &pool, std::vector<T> &arr, KeyFn key) {
+  detail::radixSort(pool, arr, key);
+}
+
+template <typename T> void RadixSort(std::vector<T> &arr) {
+  RadixSort(detail::defaultPool(), arr);
+}
+
+template <typename T, typename KeyFn> void RadixSort(std::vector<T> &arr, KeyFn key) {
+  RadixSort(detail::defaultPool(), arr, key);
+}
+
+// Tournament tree over k sorted runs: every inner node keeps the loser of
+// the match below it, so taking the smallest element replays only the
+// log2(k) matches on one leaf-to-root path. Ties go to the lower run, which
+// keeps merges stable.
+template <typename It, typename Compare = std::less<>> class LoserTree {
+public:
+  explicit LoserTree(std::vector<std::pair<It, It>> const &runs, Compare comp = Compare())
+      : comp_{comp}, k_{std::max<size_t>(runs.size(), 1)}, losers_(k_, 0) {
+    for (auto &run : runs) {
+      cur_.push_back(run.first);
+      end_.push_back(run.second);
+    }
+    if (runs.empty()) {
+      cur_.emplace_back();
+      end_.push_back(cur_.back());
+    }
+    // play the first round bottom up, leaf i sits at k + i
+    std::vector<size_t> winners(2 * k_);
+    for (size_t i = 0; i < k_; i++)
+      winners[k_ + i] = i;
+    for (size_t node = k_ - 1; node >= 1; node--) {
+      size_t a = winners[2 * node];
+      size_t b = winners[2 * node + 1];
+      winners[node] = beats(a, b) ? a : b;
+      losers_[node] = beats(a, b) ? b : a;
+    }
+    losers_[0] = k_ == 1 ? 0 : winners[1];
+  }
+
+  bool empty() const { return cur_[losers_[0]] == end_[losers_[0]]; }
+
+  // smallest element left, requires !empty()
+  auto top() const -> decltype(*std::declval<It>()) { return *cur_[losers_[0]]; }
+
+  // run the smallest element comes from
+  size_t topRun() const { return losers_[0]; }
+
+  void pop() {
+    size_t winner = losers_[0];
+    ++cur_[winner];
+    for (size_t node = (winner + k_) / 2; node >= 1; node /= 2) {
+      if (beats(losers_[node], winner))
+        std::swap(losers_[node], winner);
+    }
+    losers_[0] = winner;
+  }
+
+private:
+  bool beats(size_t a, size_t b) const {
+    if (cur_[b] == end_[b])
+      return true;
+    if (cur_[a] == end_[a])
+      return false;
+    if (comp_(*cur_[a], *cur_[b]))
+      return true;
+    return !comp_(*cur_[b], *cur_[a]) && a < b;
+  }
+
+  Compare comp_;
+  size_t k_;
+  std::vector<It> cur_;
+  std::vector<It> end_;
+  // losers_[0] is the overall winner
+  std::vector<size_t> losers_;
+};
+
+// Merge the sorted runs into out, stable across runs.
+template <typename It, typename OutIt, typename Compare = std::less<>>
+OutIt MergeRuns(std::vector<std::pair<It, It>> const &runs, OutIt out, Compare comp = Compare()) {
+  for (LoserTree<It, Compare> tree(runs, comp); !tree.empty(); tree.pop())
+    *out++ = tree.top();
+  return out;
+}
+
+// Merge sorted random access runs into out on pool. Splitters sampled from
+// every run cut all runs at the same values, each slice is merged by its
+// own task into its place in out. Equal elements stay in one slice, so the
+// merge stays stable.
+template <typename Pool, typename It, typename OutIt, typename Compare = std::less<>>
+OutIt MergeRuns(Pool &pool, std::vector<std::pair<It, It>> const &runs, OutIt out,
+                Compare comp = Compare()) {
+  using T = typename std::iterator_traits<It>::value_type;
+  size_t total = 0;
+  for (auto &run : runs)
+    total += run.second - run.first;
+  size_t slices = std::min<size_t>(std::max<size_t>(detail::poolThreads(pool, 0), 1) * 4,
+                                   total / detail::kMergeMinSlice);
+  if (slices < 2)
+    return MergeRuns(runs, out, comp);
+  std::vector<T> samples;
+  for (auto &run : runs) {
+    size_t len = run.second - run.first;
+    for (size_t i = 1; i <= slices; i++)
+      if (len > 0)
+        samples.push_back(run.first[i * len / (slices + 1)]);
+  }
+  std::sort(samples.begin(), samples.end(), comp);
+  // cuts[s][r] is where slice s starts in run r
+  std::vector<std::vector<It>> cuts(slices + 1);
+  for (size_t s = 0; s <= slices; s++) {
+    for (auto &run : runs) {
+      if (s == 0)
+        cuts[s].push_back(run.first);
+      else if (s == slices)
+        cuts[s].push_back(run.second);
+      else
+        cuts[s].push_back(std::lower_bound(run.first, run.second,
+                                           samples[s * samples.size() / slices], comp));
+    }
+  }
+  std::vector<size_t> starts(slices + 1, 0);
+  for (size_t s = 0; s < slices; s++) {
+    starts[s + 1] = starts[s];
+    for (size_t r = 0; r < runs.size(); r++)
+      starts[s + 1] += cuts[s + 1][r] - cuts[s][r];
+  }
+  detail::forEachIndex(pool, slices, [&](size_t s) {
+    std::vector<std::pair<It, It>> slice;
+    for (size_t r = 0; r < runs.size(); r++)
+      slice.emplace_back(cuts[s][r], cuts[s + 1][r]);
+    MergeRuns(slice, out + starts[s], comp);
+  });
+  return out + total;
+}
+
+// Sort list on pool with a merge sort that only splices nodes, nothing is
+// copied or moved. Halves are sorted in parallel down to a few levels past
+// the pool size, then std::list::sort takes over.
+template <typename T, typename Pool> void SortList(Pool &pool, std::list<T> &list) {
+  // log2 of about four tasks per thread
+  int depth = detail::depthLimit(std::max<size_t>(detail::poolThreads(pool, 0), 1) * 4) / 2;
+  detail::sortList(pool, list, depth);
 }
 
 template <typename T>
 std::list<T> SortList(std::list<T> arr) {
-    if (arr.empty()) return arr;
-    std::list<T> sorted;
-    sorted.splice(sorted.begin(), arr, arr.begin());
-    T const& pivot = *sorted.begin();
-    auto pivot_it = std::partition(arr.begin(), arr.end(), [&] (T const& t) {return t < pivot;});
-    std::list<T> left;
-    left.splice(left.end(), arr, arr.begin(), pivot_it);
-    std::future<std::list<T>> sorted_left = std::async(&SortList<T>, std::move(left));
-    std::future<std::list<T>> sorted_right = std::async(&SortList<T>, std::move(arr));
-    sorted.splice(sorted.end(), sorted_right.get());
-    sorted.splice(sorted.begin(), sorted_left.get());
-    return sorted;
+  SortList(detail::defaultPool(), arr);
+  return arr;
+}
+
+// STL style algorithms on pool, anything with submit() and waitUntilReady().
+// They take random access iterators, split the range into a few chunks per
+// pool thread and return once every chunk is done. The optional grain is
+// the smallest chunk; lower it for costly elements, ranges below two grains
+// run on the calling thread.
+
+template <typename Pool, typename RandomIt, typename F>
+void for_each(Pool &pool, RandomIt first, RandomIt last, F f,
+              size_t grain = detail::kDefaultGrain) {
+  size_t n = last - first;
+  detail::forEachChunk(pool, first, n, detail::chunkCount(pool, n, grain),
+                       [&](size_t, RandomIt begin, RandomIt end) { std::for_each(begin, end, f); });
+}
+
+template <typename Pool, typename RandomIt, typename OutIt, typename UnaryOp>
+OutIt transform(Pool &pool, RandomIt first, RandomIt last, OutIt d_first, UnaryOp op,
+                size_t grain = detail::kDefaultGrain) {
+  size_t n = last - first;
+  detail::forEachChunk(pool, first, n, detail::chunkCount(pool, n, grain),
+                       [&](size_t, RandomIt begin, RandomIt end) {
+                         std::transform(begin, end, d_first + (begin - first), op);
+                       });
+  return d_first + n;
+}
+
+// reduce_op must be associative. Chunks are combined left to right, so it
+// need not be commutative.
+template <typename Pool, typename RandomIt, typename T, typename BinaryOp, typename UnaryOp>
+T transform_reduce(Pool &pool, RandomIt first, RandomIt last, T init, BinaryOp reduce_op,
+                   UnaryOp transform_op, size_t grain = detail::kDefaultGrain) {
+  size_t n = last - first;
+  size_t chunks = detail::chunkCount(pool, n, grain);
+  std::vector<std::optional<T>> sums(chunks);
+  detail::forEachChunk(pool, first, n, chunks, [&](size_t c, RandomIt begin, RandomIt end) {
+    T sum = transform_op(*begin);
+    for (++begin; begin != end; ++begin)
+      sum = reduce_op(std::move(sum), transform_op(*begin));
+    sums[c].emplace(std::move(sum));
+  });
+  for (auto &sum : sums)
+    init = reduce_op(std::move(init), std::move(*sum));
+  return init;
 }
 
+// Sums of int32_t, float or double ranges add a vector at a time in every
+// chunk, so float sums can differ from a sequential one in the last bits.
+template <typename Pool, typename RandomIt, typename T, typename BinaryOp = std::plus<>>
+T reduce(Pool &pool, RandomIt first, RandomIt last, T init, BinaryOp op = BinaryOp(),
+         size_t grain = detail::kDefaultGrain) {
+  if constexpr (detail::kSimdRange<RandomIt, T> && detail::kPlus<BinaryOp, T>) {
+    size_t n = last - first;
+    size_t chunks = detail::chunkCount(pool, n, grain);
+    std::vector<T> sums(chunks);
+    detail::forEachChunk(pool, first, n, chunks, [&](size_t c, RandomIt begin, RandomIt end) {
+      sums[c] = Simd::sum(&*begin, end - begin);
+    });
+    for (T sum : sums)
+      init += sum;
+    return init;
+  }
+  return Parallel::transform_reduce(pool, first, last, std::move(init), op,
+                                    [](auto const &x) { return x; }, grain);
+}
+
+namespace detail {
+
+// First pass of the scans: chunk sums turned into the value every chunk
+// starts from. offsets[0] is init, empty for an inclusive scan.
+template <typename Pool, typename RandomIt, typename T, typename BinaryOp>
+std::vector<std::optional<T>> scanOffsets(Pool &pool, RandomIt first, size_t n, size_t chunks,
+                                          std::optional<T> init, BinaryOp op) {
+  std::vector<std::optional<T>> sums(chunks);
+  forEachChunk(pool, first, n, chunks, [&](size_t c, RandomIt begin, RandomIt end) {
+    T sum = *begin;
+    for (++begin; begin != end; ++begin)
+      sum = op(std::move(sum), *begin);
+    sums[c].emplace(std::move(sum));
+  });
+  std::vector<std::optional<T>> offsets(chunks);
+  offsets[0] = std::move(init);
+  for (size_t c = 1; c < chunks; c++)
+    offsets[c].emplace(offsets[c - 1] ? op(*offsets[c - 1], *sums[c - 1]) : *sums[c - 1]);
+  return offsets;
+}
+
+} // namespace detail
+
+// Two pass block scan: the chunks are summed, the sums are scanned in order
+// and then every chunk scans itself starting from its offset. d_first may
+// equal first.
+template <typename Pool, typename RandomIt, typename OutIt, typename BinaryOp = std::plus<>>
+OutIt inclusive_scan(Pool &pool, RandomIt first, RandomIt last, OutIt d_first,
+                     BinaryOp op = BinaryOp(), size_t grain = detail::kDefaultGrain) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  size_t n = last - first;
+  size_t chunks = detail::chunkCount(pool, n, grain);
+  if (chunks < 2)
+    return std::inclusive_scan(first, last, d_first, op);
+  if constexpr (detail::kSimdRange<RandomIt, T> && detail::kSimdRange<OutIt, T> &&
+                detail::kPlus<BinaryOp, T>) {
+    std::vector<T> offsets(chunks);
+    detail::forEachChunk(pool, first, n, chunks, [&](size_t c, RandomIt begin, RandomIt end) {
+      if (c + 1 < chunks)
+        offsets[c + 1] = Simd::sum(&*begin, end - begin);
+    });
+    for (size_t c = 1; c < chunks; c++)
+      offsets[c] += offsets[c - 1];
+    detail::forEachChunk(pool, first, n, chunks, [&](size_t c, RandomIt begin, RandomIt end) {
+      Simd::inclusiveScan(&*begin, &*(d_first + (begin - first)), end - begin, offsets[c]);
+    });
+    return d_first + n;
+  }
+  auto offsets = detail::scanOffsets<Pool, RandomIt, T>(pool, first, n, chunks, {}, op);
+  detail::forEachChunk(pool, first, n, chunks, [&](size_t c, RandomIt begin, RandomIt end) {
+    if (c == 0)
+      std::inclusive_scan(begin, end, d_first, op);
+    else
+      std::inclusive_scan(begin, end, d_first + (begin - first), op, *offsets[c]);
+  });
+  return d_first + n;
+}
+
+template <typename Pool, typename RandomIt, typename OutIt, typename T,
+          typename BinaryOp = std::plus<>>
+OutIt exclusive_scan(Pool &pool, RandomIt first, RandomIt last, OutIt d_first, T init,
+                     BinaryOp op = BinaryOp(), size_t grain = detail::kDefaultGrain) {
+  size_t n = last - first;
+  size_t chunks = detail::chunkCount(pool, n, grain);
+  if (chunks < 2)
+    return std::exclusive_scan(first, last, d_first, std::move(init), op);
+  auto offsets = detail::scanOffsets<Pool, RandomIt, T>(pool, first, n, chunks,
+                                                         std::move(init), op);
+  detail::forEachChunk(pool, first, n, chunks, [&](size_t c, RandomIt begin, RandomIt end) {
+    std::exclusive_scan(begin, end, d_first + (begin - first), *offsets[c], op);
+  });
+  return d_first + n;
+}
+
+// First element matching pred, or last. A match makes every chunk past it
+// stop at its next element and chunks that start past it return at once.
+template <typename Pool, typename RandomIt, typename Pred>
+RandomIt find_if(Pool &pool, RandomIt first, RandomIt last, Pred pred,
+                 size_t grain = detail::kDefaultGrain) {
+  size_t n = last - first;
+  std::atomic<size_t> found{n};
+  auto search = [&](size_t, RandomIt begin, RandomIt end) {
+    for (size_t i = begin - first; begin != end; ++begin, ++i) {
+      if (found.load(std::memory_order_relaxed) < i)
+        return;
+      if (pred(*begin)) {
+        size_t current = found.load(std::memory_order_relaxed);
+        while (i < current && !found.compare_exchange_weak(current, i))
+          ;
+        return;
+      }
+    }
+  };
+  detail::forEachChunk(pool, first, n, detail::chunkCount(pool, n, grain), search);
+  return first + found.load();
+}
 
 } // namespace Parallel
 
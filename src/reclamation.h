@@ -0,0 +1,368 @@
+#ifndef RECLAMATION
+#define RECLAMATION
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace Container {
+
+// Safe memory reclamation policies for the lock-free containers. Both expose
+// the same interface so a container can take either as a template parameter:
+//
+//   typename Reclaimer::Guard guard;       // protects one operation
+//   Node *node = guard.protect(0, head_);  // load a shared pointer safely
+//   Reclaimer::retire(node, &recycle);     // reclaim once nobody can see it
+
+namespace detail {
+
+struct Retired {
+  void *ptr_;
+  void (*reclaim_)(void *);
+  uint64_t epoch_;
+};
+
+// Lock-free list of per-thread records. Records are never freed, a thread
+// claims an unused one on first use and gives it back when it exits.
+template <typename Record> class RecordRegistry {
+public:
+  Record *acquire() {
+    for (Record *record = head_.load(std::memory_order_acquire);
+         record != nullptr; record = record->next_) {
+      if (!record->in_use_.load(std::memory_order_relaxed) &&
+          !record->in_use_.exchange(true, std::memory_order_acquire))
+        return record;
+    }
+    Record *record = new Record();
+    record->in_use_.store(true, std::memory_order_relaxed);
+    Record *head = head_.load(std::memory_order_relaxed);
+    do {
+      record->next_ = head;
+    } while (!head_.compare_exchange_weak(head, record,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+    count_.fetch_add(1, std::memory_order_relaxed);
+    return record;
+  }
+
+  void release(Record *record) {
+    record->in_use_.store(false, std::memory_order_release);
+  }
+
+  Record *head() const { return head_.load(std::memory_order_acquire); }
+
+  size_t size() const { return count_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<Record *> head_{nullptr};
+  std::atomic<size_t> count_{0};
+};
+
+} // namespace detail
+
+class HazardPointers {
+  struct Record;
+
+public:
+  static constexpr size_t kSlots = 8;
+  static constexpr size_t kSlotsPerGuard = 2;
+
+  // Reserves kSlotsPerGuard hazard pointers of the calling thread; guards may
+  // nest up to kSlots / kSlotsPerGuard deep.
+  class Guard {
+  public:
+    Guard() : record_{local()}, base_{record_.used_} {
+      assert(base_ + kSlotsPerGuard <= kSlots);
+      record_.used_ += kSlotsPerGuard;
+    }
+    ~Guard() {
+      for (size_t i = 0; i < kSlotsPerGuard; i++)
+        reset(i);
+      record_.used_ -= kSlotsPerGuard;
+    }
+    Guard(Guard const &) = delete;
+    Guard &operator=(Guard const &) = delete;
+
+    template <typename T> T *protect(size_t slot, std::atomic<T *> const &src) {
+      std::atomic<void *> &hazard = record_.hazards_[base_ + slot];
+      T *ptr = src.load(std::memory_order_relaxed);
+      while (true) {
+        hazard.store(ptr, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        T *again = src.load(std::memory_order_acquire);
+        if (again == ptr)
+          return ptr;
+        ptr = again;
+      }
+    }
+
+    void reset(size_t slot) {
+      record_.hazards_[base_ + slot].store(nullptr, std::memory_order_release);
+    }
+
+  private:
+    Record &record_;
+    size_t base_;
+  };
+
+  static void retire(void *ptr, void (*reclaim)(void *)) {
+    Record &record = local();
+    record.retired_.push_back({ptr, reclaim, 0});
+    if (record.retired_.size() >= threshold())
+      scan(record);
+  }
+
+  template <typename T> static void retire(T *ptr) {
+    retire(ptr, [](void *p) { delete static_cast<T *>(p); });
+  }
+
+  // reclaim everything the calling thread retired that is no longer protected
+  static void flush() { scan(local()); }
+
+private:
+  struct Record {
+    std::atomic<void *> hazards_[kSlots] = {};
+    size_t used_{0};
+    std::vector<detail::Retired> retired_;
+    std::vector<void *> scratch_;
+    std::atomic<bool> in_use_{false};
+    Record *next_{nullptr};
+  };
+
+  struct Holder {
+    Holder() : record_{registry().acquire()} {}
+    ~Holder() {
+      scan(*record_);
+      registry().release(record_);
+    }
+    Record *record_;
+  };
+
+  static detail::RecordRegistry<Record> &registry() {
+    static detail::RecordRegistry<Record> *registry =
+        new detail::RecordRegistry<Record>();
+    return *registry;
+  }
+
+  static Record &local() {
+    thread_local Holder holder;
+    return *holder.record_;
+  }
+
+  static size_t threshold() { return 2 * registry().size() * kSlots + 64; }
+
+  static void scan(Record &self) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::vector<void *> &hazards = self.scratch_;
+    hazards.clear();
+    for (Record *record = registry().head(); record != nullptr;
+         record = record->next_) {
+      for (auto &hazard : record->hazards_) {
+        if (void *ptr = hazard.load(std::memory_order_acquire))
+          hazards.push_back(ptr);
+      }
+    }
+    std::sort(hazards.begin(), hazards.end());
+    size_t kept = 0;
+    for (size_t i = 0; i < self.retired_.size(); i++) {
+      detail::Retired retired = self.retired_[i];
+      if (std::binary_search(hazards.begin(), hazards.end(), retired.ptr_))
+        self.retired_[kept++] = retired;
+      else
+        retired.reclaim_(retired.ptr_);
+    }
+    self.retired_.resize(kept);
+  }
+};
+
+// Epoch based reclamation. A guard pins the thread to the global epoch; an
+// object retired in epoch e is reclaimed once the global epoch reaches e + 2,
+// which requires every pinned thread to have observed e + 1.
+class EpochReclamation {
+  struct Record;
+
+public:
+  class Guard {
+  public:
+    Guard() : record_{local()} {
+      if (record_.nesting_++ == 0) {
+        uint64_t epoch = global_epoch_.load(std::memory_order_relaxed);
+        record_.local_epoch_.store((epoch << 1) | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+    }
+    ~Guard() {
+      if (--record_.nesting_ == 0)
+        record_.local_epoch_.store(0, std::memory_order_release);
+    }
+    Guard(Guard const &) = delete;
+    Guard &operator=(Guard const &) = delete;
+
+    template <typename T> T *protect(size_t, std::atomic<T *> const &src) {
+      return src.load(std::memory_order_acquire);
+    }
+
+    void reset(size_t) {}
+
+  private:
+    Record &record_;
+  };
+
+  static void retire(void *ptr, void (*reclaim)(void *)) {
+    Record &record = local();
+    record.retired_.push_back(
+        {ptr, reclaim, global_epoch_.load(std::memory_order_relaxed)});
+    if (record.retired_.size() % kCollectInterval == 0)
+      collect(record);
+  }
+
+  template <typename T> static void retire(T *ptr) {
+    retire(ptr, [](void *p) { delete static_cast<T *>(p); });
+  }
+
+  // try to move the epoch forward and reclaim what the calling thread retired
+  static void flush() {
+    Record &record = local();
+    tryAdvance();
+    tryAdvance();
+    collect(record);
+  }
+
+private:
+  static constexpr size_t kCollectInterval = 64;
+
+  struct Record {
+    // (epoch << 1) | 1 while pinned, 0 otherwise
+    std::atomic<uint64_t> local_epoch_{0};
+    size_t nesting_{0};
+    std::vector<detail::Retired> retired_;
+    std::atomic<bool> in_use_{false};
+    Record *next_{nullptr};
+  };
+
+  struct Holder {
+    Holder() : record_{registry().acquire()} {}
+    ~Holder() {
+      collect(*record_);
+      registry().release(record_);
+    }
+    Record *record_;
+  };
+
+  static detail::RecordRegistry<Record> &registry() {
+    static detail::RecordRegistry<Record> *registry =
+        new detail::RecordRegistry<Record>();
+    return *registry;
+  }
+
+  static Record &local() {
+    thread_local Holder holder;
+    return *holder.record_;
+  }
+
+  static void tryAdvance() {
+    uint64_t epoch = global_epoch_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (Record *record = registry().head(); record != nullptr;
+         record = record->next_) {
+      uint64_t local = record->local_epoch_.load(std::memory_order_acquire);
+      if ((local & 1) && (local >> 1) != epoch)
+        return;
+    }
+    global_epoch_.compare_exchange_strong(epoch, epoch + 1,
+                                          std::memory_order_acq_rel);
+  }
+
+  static void collect(Record &self) {
+    tryAdvance();
+    uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+    size_t kept = 0;
+    for (size_t i = 0; i < self.retired_.size(); i++) {
+      detail::Retired retired = self.retired_[i];
+      if (retired.epoch_ + 2 <= epoch)
+        retired.reclaim_(retired.ptr_);
+      else
+        self.retired_[kept++] = retired;
+    }
+    self.retired_.resize(kept);
+  }
+
+  static inline std::atomic<uint64_t> global_epoch_{0};
+};
+
+// Packs a 16-bit modification tag above a 48-bit pointer so a CAS on the
+// word fails if the pointer was popped and pushed back in between (ABA).
+// Address spaces wider than 48 bits (x86-64 LA57, 52-bit AArch64) can hand out
+// pointers the tag would clobber, pack() aborts on those in every build.
+template <typename T> struct TaggedPointer {
+  static_assert(sizeof(T *) == sizeof(uint64_t), "needs 64-bit pointers");
+  static constexpr unsigned kPointerBits = 48;
+  static constexpr uint64_t kPointerMask = (uint64_t(1) << kPointerBits) - 1;
+
+  static uint64_t pack(T *ptr, uint64_t tag) {
+    uint64_t bits = reinterpret_cast<uint64_t>(ptr);
+    if ((bits & ~kPointerMask) != 0)
+      std::abort();
+    return bits | (tag << kPointerBits);
+  }
+
+  static T *pointer(uint64_t word) {
+    return reinterpret_cast<T *>(word & kPointerMask);
+  }
+
+  static uint64_t tag(uint64_t word) { return word >> kPointerBits; }
+};
+
+// Lock-free free-list of recycled nodes. Node needs an std::atomic<Node *>
+// next_ member. Nodes only go back to the allocator in clear() and the
+// destructor, which is what makes reading next_ of a node another thread just
+// popped safe: nobody may pop concurrently with either.
+template <typename Node> class FreeList {
+  using Tagged = TaggedPointer<Node>;
+
+public:
+  FreeList() = default;
+  ~FreeList() { clear(); }
+  FreeList(FreeList const &) = delete;
+  FreeList &operator=(FreeList const &) = delete;
+
+  // delete the cached nodes, pushes may still run meanwhile
+  void clear() {
+    while (Node *node = pop())
+      delete node;
+  }
+
+  Node *pop() {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (true) {
+      Node *node = Tagged::pointer(head);
+      if (node == nullptr)
+        return nullptr;
+      Node *next = node->next_.load(std::memory_order_relaxed);
+      if (head_.compare_exchange_weak(head,
+                                      Tagged::pack(next, Tagged::tag(head) + 1),
+                                      std::memory_order_acquire,
+                                      std::memory_order_acquire))
+        return node;
+    }
+  }
+
+  void push(Node *node) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    do {
+      node->next_.store(Tagged::pointer(head), std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(
+        head, Tagged::pack(node, Tagged::tag(head) + 1),
+        std::memory_order_release, std::memory_order_relaxed));
+  }
+
+private:
+  std::atomic<uint64_t> head_{0};
+};
+
+} // namespace Container
+
+#endif
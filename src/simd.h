@@ -0,0 +1,565 @@
+#ifndef SIMD
+#define SIMD
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PARALLEL_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace Parallel {
+
+// Vector kernels for contiguous int32_t, float and double arrays. On x86-64
+// there are AVX2 and SSE4.2 versions, picked at run time by what the CPU
+// supports, so the code builds without -mavx2; elsewhere only the scalar
+// loops exist. Vector sums add in a different order than a loop does, so
+// float results can differ in the last bits. min and max of arrays holding
+// NaN are unspecified.
+namespace Simd {
+
+enum class Isa { kScalar, kSse42, kAvx2 };
+
+template <typename T>
+constexpr bool kVectorizable = std::is_same<T, int32_t>::value ||
+                               std::is_same<T, float>::value ||
+                               std::is_same<T, double>::value;
+
+// best instruction set the CPU running us supports, checked once
+inline Isa bestIsa() {
+#ifdef PARALLEL_SIMD_X86
+  static Isa const isa = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+      return Isa::kAvx2;
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+      return Isa::kSse42;
+    return Isa::kScalar;
+  }();
+  return isa;
+#else
+  return Isa::kScalar;
+#endif
+}
+
+namespace detail {
+
+enum class Reduction { kSum, kMin, kMax };
+
+template <Reduction kOp, typename T> T combine(T a, T b) {
+  if constexpr (kOp == Reduction::kSum)
+    return a + b;
+  else if constexpr (kOp == Reduction::kMin)
+    return b < a ? b : a;
+  else
+    return a < b ? b : a;
+}
+
+template <Reduction kOp, typename T> T reduceScalar(T const *data, size_t n, T init) {
+  for (size_t i = 0; i < n; i++)
+    init = combine<kOp>(init, data[i]);
+  return init;
+}
+
+template <typename T> void scanScalar(T const *in, T *out, size_t n, T init) {
+  for (size_t i = 0; i < n; i++) {
+    init += in[i];
+    out[i] = init;
+  }
+}
+
+// Stable partition of data[first, n) by x < pivot: the smaller elements are
+// compacted to data + lo, the others appended to scratch + hi. Returns the
+// new lo and hi.
+template <typename T>
+std::pair<size_t, size_t> partitionScalar(T *data, size_t first, size_t n, T pivot, T *scratch,
+                                          size_t lo, size_t hi) {
+  for (size_t i = first; i < n; i++) {
+    T x = data[i];
+    bool less = x < pivot;
+    // both stores happen, only one index moves; lo never passes i
+    data[lo] = x;
+    scratch[hi] = x;
+    lo += less;
+    hi += !less;
+  }
+  return {lo, hi};
+}
+
+// Longest partition that borrows the per thread buffer, 512 KB of doubles.
+constexpr size_t kScratchMax = size_t(1) << 16;
+
+// A buffer of n elements: the calling thread's own up to kScratchMax, which
+// never grows past that, else owned, freed when the caller's call returns.
+template <typename T> T *scratch(size_t n, std::vector<T> &owned) {
+  if (n > kScratchMax) {
+    owned.resize(n);
+    return owned.data();
+  }
+  static thread_local std::vector<T> buffer;
+  if (buffer.size() < n)
+    buffer.resize(n);
+  return buffer.data();
+}
+
+// Kernels shared by the instruction sets, written against a vector type V.
+// They carry no target attribute of their own and are only called from the
+// flattened wrappers below, which inline them with the wrapper's target. V
+// takes and returns vectors by reference: passing them by value from code
+// without the target would change the ABI of the call.
+
+template <Reduction kOp, typename V> void accumulate(typename V::Vec &acc, typename V::Vec const &x) {
+  if constexpr (kOp == Reduction::kSum)
+    V::add(acc, x);
+  else if constexpr (kOp == Reduction::kMin)
+    V::min(acc, x);
+  else
+    V::max(acc, x);
+}
+
+template <Reduction kOp, typename V, typename T = typename V::T>
+T reduceKernel(T const *data, size_t n, T init) {
+  constexpr size_t L = V::kLanes;
+  size_t i = 0;
+  if (n >= 4 * L) {
+    // four independent accumulators hide the latency of the adds
+    typename V::Vec acc[4];
+    typename V::Vec x;
+    for (size_t k = 0; k < 4; k++)
+      V::load(acc[k], data + k * L);
+    for (i = 4 * L; i + 4 * L <= n; i += 4 * L) {
+      for (size_t k = 0; k < 4; k++) {
+        V::load(x, data + i + k * L);
+        accumulate<kOp, V>(acc[k], x);
+      }
+    }
+    accumulate<kOp, V>(acc[0], acc[1]);
+    accumulate<kOp, V>(acc[2], acc[3]);
+    accumulate<kOp, V>(acc[0], acc[2]);
+    T lanes[L];
+    V::store(lanes, acc[0]);
+    init = reduceScalar<kOp>(lanes, L, init);
+  }
+  return reduceScalar<kOp>(data + i, n - i, init);
+}
+
+// Every vector is scanned in registers with log2(lanes) shifted adds and the
+// running total is broadcast into the next one.
+template <typename V, typename T = typename V::T>
+void scanKernel(T const *in, T *out, size_t n, T init) {
+  constexpr size_t L = V::kLanes;
+  typename V::Vec carry;
+  typename V::Vec x;
+  V::splat(carry, init);
+  size_t i = 0;
+  for (; i + L <= n; i += L) {
+    V::load(x, in + i);
+    V::prefix(x);
+    V::add(x, carry);
+    V::store(out + i, x);
+    V::last(carry, x);
+  }
+  if (i > 0)
+    init = out[i - 1];
+  scanScalar(in + i, out + i, n - i, init);
+}
+
+// A compare mask picks the lanes below pivot; compress moves them to the
+// front of a vector, which is stored at the low end of data and advanced by
+// their count. The other lanes go to scratch the same way. A full vector
+// store never reaches past the elements already loaded.
+template <typename V, typename T = typename V::T>
+size_t partitionKernel(T *data, size_t n, T pivot, T *scratch) {
+  constexpr size_t L = V::kLanes;
+  constexpr unsigned kAll = (1u << L) - 1;
+  typename V::Vec p;
+  typename V::Vec x;
+  typename V::Vec part;
+  V::splat(p, pivot);
+  size_t lo = 0;
+  size_t hi = 0;
+  size_t i = 0;
+  for (; i + L <= n; i += L) {
+    V::load(x, data + i);
+    unsigned mask = V::less(x, p);
+    unsigned count = __builtin_popcount(mask);
+    V::compress(part, x, mask);
+    V::store(data + lo, part);
+    V::compress(part, x, ~mask & kAll);
+    V::store(scratch + hi, part);
+    lo += count;
+    hi += L - count;
+  }
+  auto counts = partitionScalar(data, i, n, pivot, scratch, lo, hi);
+  std::copy(scratch, scratch + counts.second, data + counts.first);
+  return counts.first;
+}
+
+// Byte shuffles that move the lanes set in a mask to the front, for SSE.
+template <size_t kLanes> constexpr auto shuffleTable() {
+  constexpr size_t kBytes = 16 / kLanes;
+  std::array<std::array<uint8_t, 16>, (1 << kLanes)> table{};
+  for (size_t mask = 0; mask < table.size(); mask++) {
+    size_t out = 0;
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      if (mask & (size_t(1) << lane)) {
+        for (size_t b = 0; b < kBytes; b++)
+          table[mask][out * kBytes + b] = static_cast<uint8_t>(lane * kBytes + b);
+        out++;
+      }
+    }
+    for (size_t b = out * kBytes; b < 16; b++)
+      table[mask][b] = 0x80;
+  }
+  return table;
+}
+
+// 32 bit lane indices packed in bytes, for AVX2 permutes over 8 dwords.
+template <size_t kLanes> constexpr auto permuteTable() {
+  constexpr size_t kDwords = 8 / kLanes;
+  std::array<uint64_t, (1 << kLanes)> table{};
+  for (size_t mask = 0; mask < table.size(); mask++) {
+    size_t out = 0;
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      if (mask & (size_t(1) << lane)) {
+        for (size_t d = 0; d < kDwords; d++)
+          table[mask] |= uint64_t(lane * kDwords + d) << (8 * (out * kDwords + d));
+        out++;
+      }
+    }
+  }
+  return table;
+}
+
+} // namespace detail
+
+#ifdef PARALLEL_SIMD_X86
+
+// The wrappers inline the shared kernels and everything they call, so the
+// kernels are compiled for the wrapper's instruction set.
+#define PARALLEL_SIMD_FLATTEN __attribute__((flatten))
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,popcnt"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,popcnt")
+#endif
+
+namespace avx2 {
+
+inline constexpr auto kPermute32 = detail::permuteTable<8>();
+inline constexpr auto kPermute64 = detail::permuteTable<4>();
+
+inline __m256i permutation(uint64_t packed) {
+  return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(packed)));
+}
+
+// lane i takes lane i - k, the first k lanes are cleared by the caller
+inline __m256i shiftIndex(int k) {
+  return _mm256_max_epi32(
+      _mm256_sub_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(k)),
+      _mm256_setzero_si256());
+}
+
+template <typename T> struct Vector;
+
+template <> struct Vector<int32_t> {
+  using T = int32_t;
+  using Vec = __m256i;
+  static constexpr size_t kLanes = 8;
+  static void load(Vec &v, T const *p) { v = _mm256_loadu_si256(reinterpret_cast<Vec const *>(p)); }
+  static void store(T *p, Vec const &v) { _mm256_storeu_si256(reinterpret_cast<Vec *>(p), v); }
+  static void splat(Vec &v, T x) { v = _mm256_set1_epi32(x); }
+  static void add(Vec &a, Vec const &b) { a = _mm256_add_epi32(a, b); }
+  static void min(Vec &a, Vec const &b) { a = _mm256_min_epi32(a, b); }
+  static void max(Vec &a, Vec const &b) { a = _mm256_max_epi32(a, b); }
+  static unsigned less(Vec const &a, Vec const &b) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)));
+  }
+  static void compress(Vec &out, Vec const &v, unsigned mask) {
+    out = _mm256_permutevar8x32_epi32(v, permutation(kPermute32[mask]));
+  }
+  template <int k> static __m256i shift(__m256i v) {
+    return _mm256_blend_epi32(_mm256_permutevar8x32_epi32(v, shiftIndex(k)),
+                              _mm256_setzero_si256(), (1 << k) - 1);
+  }
+  static void prefix(Vec &v) {
+    v = _mm256_add_epi32(v, shift<1>(v));
+    v = _mm256_add_epi32(v, shift<2>(v));
+    v = _mm256_add_epi32(v, shift<4>(v));
+  }
+  static void last(Vec &out, Vec const &v) {
+    out = _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(7));
+  }
+};
+
+template <> struct Vector<float> {
+  using T = float;
+  using Vec = __m256;
+  static constexpr size_t kLanes = 8;
+  static void load(Vec &v, T const *p) { v = _mm256_loadu_ps(p); }
+  static void store(T *p, Vec const &v) { _mm256_storeu_ps(p, v); }
+  static void splat(Vec &v, T x) { v = _mm256_set1_ps(x); }
+  static void add(Vec &a, Vec const &b) { a = _mm256_add_ps(a, b); }
+  static void min(Vec &a, Vec const &b) { a = _mm256_min_ps(a, b); }
+  static void max(Vec &a, Vec const &b) { a = _mm256_max_ps(a, b); }
+  static unsigned less(Vec const &a, Vec const &b) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ));
+  }
+  static void compress(Vec &out, Vec const &v, unsigned mask) {
+    out = _mm256_permutevar8x32_ps(v, permutation(kPermute32[mask]));
+  }
+  template <int k> static __m256 shift(__m256 v) {
+    return _mm256_blend_ps(_mm256_permutevar8x32_ps(v, shiftIndex(k)), _mm256_setzero_ps(),
+                           (1 << k) - 1);
+  }
+  static void prefix(Vec &v) {
+    v = _mm256_add_ps(v, shift<1>(v));
+    v = _mm256_add_ps(v, shift<2>(v));
+    v = _mm256_add_ps(v, shift<4>(v));
+  }
+  static void last(Vec &out, Vec const &v) {
+    out = _mm256_permutevar8x32_ps(v, _mm256_set1_epi32(7));
+  }
+};
+
+template <> struct Vector<double> {
+  using T = double;
+  using Vec = __m256d;
+  static constexpr size_t kLanes = 4;
+  static void load(Vec &v, T const *p) { v = _mm256_loadu_pd(p); }
+  static void store(T *p, Vec const &v) { _mm256_storeu_pd(p, v); }
+  static void splat(Vec &v, T x) { v = _mm256_set1_pd(x); }
+  static void add(Vec &a, Vec const &b) { a = _mm256_add_pd(a, b); }
+  static void min(Vec &a, Vec const &b) { a = _mm256_min_pd(a, b); }
+  static void max(Vec &a, Vec const &b) { a = _mm256_max_pd(a, b); }
+  static unsigned less(Vec const &a, Vec const &b) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ));
+  }
+  static void compress(Vec &out, Vec const &v, unsigned mask) {
+    out = _mm256_castsi256_pd(
+        _mm256_permutevar8x32_epi32(_mm256_castpd_si256(v), permutation(kPermute64[mask])));
+  }
+  static void prefix(Vec &v) {
+    __m256d zero = _mm256_setzero_pd();
+    v = _mm256_add_pd(
+        v, _mm256_blend_pd(_mm256_permute4x64_pd(v, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1));
+    v = _mm256_add_pd(
+        v, _mm256_blend_pd(_mm256_permute4x64_pd(v, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x3));
+  }
+  static void last(Vec &out, Vec const &v) {
+    out = _mm256_permute4x64_pd(v, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+};
+
+template <detail::Reduction kOp, typename T>
+PARALLEL_SIMD_FLATTEN T reduce(T const *data, size_t n, T init) {
+  return detail::reduceKernel<kOp, Vector<T>>(data, n, init);
+}
+
+template <typename T> PARALLEL_SIMD_FLATTEN void scan(T const *in, T *out, size_t n, T init) {
+  detail::scanKernel<Vector<T>>(in, out, n, init);
+}
+
+template <typename T> PARALLEL_SIMD_FLATTEN size_t partition(T *data, size_t n, T pivot, T *scratch) {
+  return detail::partitionKernel<Vector<T>>(data, n, pivot, scratch);
+}
+
+} // namespace avx2
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("sse4.2,popcnt"))), apply_to = function)
+#else
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+#endif
+
+namespace sse42 {
+
+inline constexpr auto kShuffle32 = detail::shuffleTable<4>();
+inline constexpr auto kShuffle64 = detail::shuffleTable<2>();
+
+inline __m128i shuffle(__m128i v, std::array<uint8_t, 16> const &bytes) {
+  return _mm_shuffle_epi8(v, _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes.data())));
+}
+
+template <typename T> struct Vector;
+
+template <> struct Vector<int32_t> {
+  using T = int32_t;
+  using Vec = __m128i;
+  static constexpr size_t kLanes = 4;
+  static void load(Vec &v, T const *p) { v = _mm_loadu_si128(reinterpret_cast<Vec const *>(p)); }
+  static void store(T *p, Vec const &v) { _mm_storeu_si128(reinterpret_cast<Vec *>(p), v); }
+  static void splat(Vec &v, T x) { v = _mm_set1_epi32(x); }
+  static void add(Vec &a, Vec const &b) { a = _mm_add_epi32(a, b); }
+  static void min(Vec &a, Vec const &b) { a = _mm_min_epi32(a, b); }
+  static void max(Vec &a, Vec const &b) { a = _mm_max_epi32(a, b); }
+  static unsigned less(Vec const &a, Vec const &b) {
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(a, b)));
+  }
+  static void compress(Vec &out, Vec const &v, unsigned mask) { out = shuffle(v, kShuffle32[mask]); }
+  static void prefix(Vec &v) {
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+  }
+  static void last(Vec &out, Vec const &v) { out = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)); }
+};
+
+template <> struct Vector<float> {
+  using T = float;
+  using Vec = __m128;
+  static constexpr size_t kLanes = 4;
+  static void load(Vec &v, T const *p) { v = _mm_loadu_ps(p); }
+  static void store(T *p, Vec const &v) { _mm_storeu_ps(p, v); }
+  static void splat(Vec &v, T x) { v = _mm_set1_ps(x); }
+  static void add(Vec &a, Vec const &b) { a = _mm_add_ps(a, b); }
+  static void min(Vec &a, Vec const &b) { a = _mm_min_ps(a, b); }
+  static void max(Vec &a, Vec const &b) { a = _mm_max_ps(a, b); }
+  static unsigned less(Vec const &a, Vec const &b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+  static void compress(Vec &out, Vec const &v, unsigned mask) {
+    out = _mm_castsi128_ps(shuffle(_mm_castps_si128(v), kShuffle32[mask]));
+  }
+  static void prefix(Vec &v) {
+    v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+    v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+  }
+  static void last(Vec &out, Vec const &v) { out = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)); }
+};
+
+template <> struct Vector<double> {
+  using T = double;
+  using Vec = __m128d;
+  static constexpr size_t kLanes = 2;
+  static void load(Vec &v, T const *p) { v = _mm_loadu_pd(p); }
+  static void store(T *p, Vec const &v) { _mm_storeu_pd(p, v); }
+  static void splat(Vec &v, T x) { v = _mm_set1_pd(x); }
+  static void add(Vec &a, Vec const &b) { a = _mm_add_pd(a, b); }
+  static void min(Vec &a, Vec const &b) { a = _mm_min_pd(a, b); }
+  static void max(Vec &a, Vec const &b) { a = _mm_max_pd(a, b); }
+  static unsigned less(Vec const &a, Vec const &b) { return _mm_movemask_pd(_mm_cmplt_pd(a, b)); }
+  static void compress(Vec &out, Vec const &v, unsigned mask) {
+    out = _mm_castsi128_pd(shuffle(_mm_castpd_si128(v), kShuffle64[mask]));
+  }
+  static void prefix(Vec &v) {
+    v = _mm_add_pd(v, _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(v), 8)));
+  }
+  static void last(Vec &out, Vec const &v) { out = _mm_unpackhi_pd(v, v); }
+};
+
+template <detail::Reduction kOp, typename T>
+PARALLEL_SIMD_FLATTEN T reduce(T const *data, size_t n, T init) {
+  return detail::reduceKernel<kOp, Vector<T>>(data, n, init);
+}
+
+template <typename T> PARALLEL_SIMD_FLATTEN void scan(T const *in, T *out, size_t n, T init) {
+  detail::scanKernel<Vector<T>>(in, out, n, init);
+}
+
+template <typename T> PARALLEL_SIMD_FLATTEN size_t partition(T *data, size_t n, T pivot, T *scratch) {
+  return detail::partitionKernel<Vector<T>>(data, n, pivot, scratch);
+}
+
+} // namespace sse42
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#undef PARALLEL_SIMD_FLATTEN
+
+#endif // PARALLEL_SIMD_X86
+
+namespace detail {
+
+template <Reduction kOp, typename T> T reduce(T const *data, size_t n, T init, Isa isa) {
+  static_assert(kVectorizable<T>, "int32_t, float or double only");
+  switch (std::min(isa, bestIsa())) {
+#ifdef PARALLEL_SIMD_X86
+  case Isa::kAvx2:
+    return avx2::reduce<kOp>(data, n, init);
+  case Isa::kSse42:
+    return sse42::reduce<kOp>(data, n, init);
+#endif
+  default:
+    return reduceScalar<kOp>(data, n, init);
+  }
+}
+
+} // namespace detail
+
+// The functions take an optional isa to force a slower path, e.g. in tests;
+// one the CPU lacks falls back to the best it has.
+
+template <typename T> T sum(T const *data, size_t n, Isa isa = bestIsa()) {
+  return detail::reduce<detail::Reduction::kSum>(data, n, T(), isa);
+}
+
+// smallest element, requires n > 0
+template <typename T> T min(T const *data, size_t n, Isa isa = bestIsa()) {
+  return detail::reduce<detail::Reduction::kMin>(data + 1, n - 1, data[0], isa);
+}
+
+// largest element, requires n > 0
+template <typename T> T max(T const *data, size_t n, Isa isa = bestIsa()) {
+  return detail::reduce<detail::Reduction::kMax>(data + 1, n - 1, data[0], isa);
+}
+
+// out[i] = init + in[0] + ... + in[i]; out may equal in.
+template <typename T>
+void inclusiveScan(T const *in, T *out, size_t n, T init = T(), Isa isa = bestIsa()) {
+  static_assert(kVectorizable<T>, "int32_t, float or double only");
+  switch (std::min(isa, bestIsa())) {
+#ifdef PARALLEL_SIMD_X86
+  case Isa::kAvx2:
+    return avx2::scan(in, out, n, init);
+  case Isa::kSse42:
+    return sse42::scan(in, out, n, init);
+#endif
+  default:
+    return detail::scanScalar(in, out, n, init);
+  }
+}
+
+// Stable partition of data by x < pivot, returns how many are smaller. The
+// other elements pass through buffer, which holds at least n elements.
+template <typename T>
+size_t partition(T *data, size_t n, T pivot, T *buffer, Isa isa = bestIsa()) {
+  static_assert(kVectorizable<T>, "int32_t, float or double only");
+  switch (std::min(isa, bestIsa())) {
+#ifdef PARALLEL_SIMD_X86
+  case Isa::kAvx2:
+    return avx2::partition(data, n, pivot, buffer);
+  case Isa::kSse42:
+    return sse42::partition(data, n, pivot, buffer);
+#endif
+  default: {
+    auto counts = detail::partitionScalar(data, 0, n, pivot, buffer, 0, 0);
+    std::copy(buffer, buffer + counts.second, data + counts.first);
+    return counts.first;
+  }
+  }
+}
+
+// As above, staging through a buffer of the calling thread's, which keeps at
+// most detail::kScratchMax elements; longer ranges allocate one for the call.
+template <typename T> size_t partition(T *data, size_t n, T pivot, Isa isa = bestIsa()) {
+  std::vector<T> owned;
+  return partition(data, n, pivot, detail::scratch<T>(n, owned), isa);
+}
+
+} // namespace Simd
+} // namespace Parallel
+
+#endif
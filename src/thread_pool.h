@@ -1,10 +1,22 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include "cancellation.h"
+#include "future.h"
+#include "inplace_function.h"
 #include "thread_safe_container.h"
+#include "timer_wheel.h"
+#include "topology.h"
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <condition_variable>
+#include <deque>
 #include <exception>
 #include <functional>
+#include <iterator>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <type_traits>
@@ -15,11 +27,178 @@ namespace Thread {
 using Task = std::function<void()>;
 class ThreadPool {
 public:
+  using Clock = TimerWheel::Clock;
+  using TimerId = TimerWheel::TimerId;
+
   virtual ~ThreadPool() = default;
   virtual bool addTask(Task const &task) = 0;
   virtual bool addTask(Task &&task) = 0;
-  virtual void shutdown() = 0;
   virtual bool start() = 0;
+
+  // Stop taking tasks, run every queued one and join the workers.
+  virtual void shutdown() {
+    stopTimers();
+    close();
+    join();
+  }
+
+  // Stop taking tasks and give the queued ones at most timeout to run.
+  // Returns true once every worker is done and joined. On false the pool
+  // keeps draining; shutdown() waits for the rest, shutdownNow() drops it.
+  virtual bool drain(Clock::duration timeout) {
+    stopTimers();
+    close();
+    if (!waitForWorkers(timeout))
+      return false;
+    join();
+    return true;
+  }
+
+  // Stop taking tasks, cancel cancellationToken() and wait only for the
+  // tasks already running. Returns the queued tasks that never started.
+  virtual std::vector<Task> shutdownNow() = 0;
+
+  // cancelled by shutdownNow(), long running tasks can poll it
+  CancellationToken cancellationToken() const { return cancellation_.token(); }
+
+  // Delayed and periodic tasks. A timer thread per pool, started on first
+  // use, hands due tasks to addTask(). Returns an invalid id once the pool
+  // is shut down.
+  TimerId scheduleAfter(Clock::duration delay, Task task) {
+    return scheduleAt(Clock::now() + delay, std::move(task));
+  }
+
+  TimerId scheduleAt(Clock::time_point deadline, Task task) {
+    TimerWheel *timers = timerWheel();
+    if (timers == nullptr)
+      return {};
+    return timers->schedule(deadline, [this, task = std::move(task)]() mutable {
+      addTask(std::move(task));
+    });
+  }
+
+  // the first run is one period from now
+  TimerId scheduleEvery(Clock::duration period, Task task) {
+    TimerWheel *timers = timerWheel();
+    if (timers == nullptr)
+      return {};
+    return timers->scheduleEvery(
+        period, [this, task = std::move(task)]() { addTask(task); });
+  }
+
+  // Returns true if the timer was pending.
+  bool cancelTimer(TimerId id) {
+    TimerWheel *timers = timerWheel();
+    return timers != nullptr && timers->cancel(id);
+  }
+
+protected:
+  // Stop taking tasks and wake the workers, which run what is queued and
+  // exit.
+  virtual void close() = 0;
+
+  virtual void join() {
+    for (auto &worker : workers_) {
+      if (worker.joinable())
+        worker.join();
+    }
+  }
+
+  // Start count workers in workers_, worker(i) being the loop of the i-th.
+  // On a failed spawn the pool is shut down and false returned.
+  template <typename Worker> bool startWorkers(size_t count, Worker worker) {
+    for (size_t i = 0; i < count; i++) {
+      workers_.emplace_back();
+      if (!spawnWorker(workers_.back(), worker, i)) {
+        workers_.pop_back();
+        shutdown();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Run args as a worker on thread. The worker is counted before it runs,
+  // its exit may come first; returns false if the thread failed to spawn.
+  template <typename... Args> bool spawnWorker(std::thread &thread, Args &&...args) {
+    workerStarted();
+    try {
+      thread = std::thread(std::forward<Args>(args)...);
+    } catch (std::exception &e) {
+      // the worker that failed to spawn
+      workerExited();
+      return false;
+    }
+    return true;
+  }
+
+  // shutdownNow() up to collecting the tasks that never started
+  void abortAndJoin() {
+    stopTimers();
+    abort();
+    close();
+    join();
+  }
+
+  // Every worker is counted from before its thread starts until it leaves
+  // its loop, drain() waits for the count to drop to zero.
+  void workerStarted() {
+    std::lock_guard<std::mutex> lck(live_mtx_);
+    live_workers_++;
+  }
+
+  void workerExited() {
+    std::lock_guard<std::mutex> lck(live_mtx_);
+    if (--live_workers_ == 0)
+      live_cv_.notify_all();
+  }
+
+  bool waitForWorkers(Clock::duration timeout) {
+    std::unique_lock<std::mutex> lck(live_mtx_);
+    return live_cv_.wait_for(lck, timeout, [this] { return live_workers_ == 0; });
+  }
+
+  // set by shutdownNow(), workers stop taking tasks
+  void abort() { cancellation_.cancel(); }
+  bool aborted() const { return cancellation_.isCancelled(); }
+
+  // shutdownNow() hands back move-only tasks as copyable Tasks
+  static Task toTask(InplaceFunction<64> &&task) {
+    auto shared = std::make_shared<InplaceFunction<64>>(std::move(task));
+    return [shared]() { (*shared)(); };
+  }
+
+  // Drops pending timers and joins the timer thread, every shutdown() calls
+  // this first so no timer fires into a pool that is going away.
+  void stopTimers() {
+    {
+      std::lock_guard<std::mutex> lck(timers_mtx_);
+      timers_stopped_ = true;
+    }
+    // timers_ is never replaced once created
+    if (timers_)
+      timers_->stop();
+  }
+
+  std::list<std::thread> workers_;
+
+private:
+  TimerWheel *timerWheel() {
+    std::lock_guard<std::mutex> lck(timers_mtx_);
+    if (timers_stopped_)
+      return nullptr;
+    if (!timers_)
+      timers_.reset(new TimerWheel());
+    return timers_.get();
+  }
+
+  std::mutex timers_mtx_;
+  std::unique_ptr<TimerWheel> timers_;
+  bool timers_stopped_{false};
+  CancellationSource cancellation_;
+  std::mutex live_mtx_;
+  std::condition_variable live_cv_;
+  size_t live_workers_{0};
 };
 
 
@@ -36,6 +215,142 @@ private:
   std::atomic_flag flag;
 };
 
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Eventcount used to park idle workers. A waiter announces itself with
+// prepareWait(), re-checks its condition and only then blocks in wait(), so a
+// notify issued in between is never lost. notifyOne() costs a fence and a load
+// while nobody is parked.
+class EventCount {
+public:
+  using Key = uint64_t;
+
+  Key prepareWait() {
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return epoch_.load(std::memory_order_acquire);
+  }
+
+  void cancelWait() { waiters_.fetch_sub(1, std::memory_order_seq_cst); }
+
+  void wait(Key key) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    cv_.wait(lck, [&] { return epoch_.load(std::memory_order_relaxed) != key; });
+    lck.unlock();
+    waiters_.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  void notifyOne() {
+    if (!bumpEpoch())
+      return;
+    cv_.notify_one();
+  }
+
+  void notifyAll() {
+    if (!bumpEpoch())
+      return;
+    cv_.notify_all();
+  }
+
+private:
+  // returns false if there was nobody to wake up
+  bool bumpEpoch() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) == 0)
+      return false;
+    std::unique_lock<std::mutex> lck(mtx_);
+    epoch_.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+  std::atomic<uint32_t> waiters_{0};
+  std::atomic<Key> epoch_{0};
+  std::mutex mtx_;
+  std::condition_variable cv_;
+};
+
+// Shutdown gate for pools whose queues take no lock. A post pushes between
+// enter() and leave(), and a worker exits only after it saw the intake
+// closed, then quiet(), then its queues empty. A post thus either finds the
+// intake closed or has pushed before the last worker looks, so no accepted
+// task is left behind.
+class Intake {
+public:
+  void open() { closed_.store(false); }
+  void close() { closed_.store(true); }
+  bool closed() const { return closed_.load(); }
+
+  // false once closed, the caller must not push then
+  bool enter() {
+    posting_.fetch_add(1);
+    if (closed_.load()) {
+      leave();
+      return false;
+    }
+    return true;
+  }
+
+  void leave() { posting_.fetch_sub(1, std::memory_order_release); }
+
+  // no post is between enter() and leave()
+  bool quiet() const { return posting_.load() == 0; }
+
+  // wait for the posts under way, e.g. before collecting what is queued
+  void settle() const {
+    while (!quiet())
+      std::this_thread::yield();
+  }
+
+private:
+  std::atomic<bool> closed_{true};
+  std::atomic<size_t> posting_{0};
+};
+
+// How a worker waits when it finds no work: spin, then yield, then park.
+struct IdlePolicy {
+  size_t spins{64};
+  size_t yields{16};
+  bool park{true};
+};
+
+class Backoff {
+public:
+  explicit Backoff(IdlePolicy const &policy) : policy_{policy} {}
+
+  void reset() { rounds_ = 0; }
+
+  // Wait a little longer each round; once spinning and yielding are used up,
+  // park on the eventcount until ready() holds.
+  template <typename Ready> void idle(EventCount &event, Ready ready) {
+    if (rounds_ < policy_.spins) {
+      rounds_++;
+      cpuRelax();
+      return;
+    }
+    if (rounds_ < policy_.spins + policy_.yields || !policy_.park) {
+      rounds_++;
+      std::this_thread::yield();
+      return;
+    }
+    EventCount::Key key = event.prepareWait();
+    if (ready()) {
+      event.cancelWait();
+      return;
+    }
+    event.wait(key);
+  }
+
+private:
+  IdlePolicy const &policy_;
+  size_t rounds_{0};
+};
+
 namespace v1 {
 
 class ThreadPoolImpl : public ThreadPool {
@@ -45,28 +360,20 @@ public:
   ThreadPoolImpl() : threads_{std::thread::hardware_concurrency()} {}
 
   ~ThreadPoolImpl() override { shutdown(); }
+
+  size_t threads() const { return threads_; }
+
   bool start() override {
     shutdown_.store(false);
-    try {
-      for (size_t i = 0; i < threads_; i++) {
-        workers_.emplace_back(&ThreadPoolImpl::worker, this);
-      }
-    }
-    catch (std::exception& e) {
-      shutdown();
-      return false;
-    }
-    return true;
+    return startWorkers(threads_, [this](size_t) { worker(); });
   }
 
-  void shutdown() override {
-    if (shutdown_.load())
-      return;
-    shutdown_.store(true);
-    cv_.notify_all();
-    for (auto &worker : workers_) {
-      worker.join();
-    }
+  std::vector<Task> shutdownNow() override {
+    abortAndJoin();
+    std::vector<Task> pending(std::make_move_iterator(tasks_.begin()),
+                              std::make_move_iterator(tasks_.end()));
+    tasks_.clear();
+    return pending;
   }
 
   bool addTask(Task &&task) override {
@@ -90,11 +397,19 @@ public:
   }
 
 private:
+  void close() override {
+    {
+      std::lock_guard<std::mutex> lck(mtx_);
+      shutdown_.store(true);
+    }
+    cv_.notify_all();
+  }
+
   void worker() {
     while (true) {
       std::unique_lock<std::mutex> lck(mtx_);
       cv_.wait(lck, [this] { return !tasks_.empty() || shutdown_.load(); });
-      if (shutdown_ && tasks_.empty()) {
+      if ((shutdown_ && tasks_.empty()) || aborted()) {
         lck.unlock();
         cv_.notify_all();
         break;
@@ -105,233 +420,1138 @@ private:
       cv_.notify_one();
       task();
     }
+    workerExited();
   }
 
   std::condition_variable cv_;
   std::mutex mtx_;
   std::list<Task> tasks_;
   size_t threads_;
-  std::atomic<bool> shutdown_;
-  std::list<std::thread> workers_;
+  std::atomic<bool> shutdown_{true};
 };
 } // namespace v1
 
 namespace v2 {
-class ThreadPoolImpl : public ThreadPool {
+// TaskQueue is any queue template with push/try_push/try_pop/empty, e.g.
+// Container::ThreadSafeStack or Container::BoundedQueue. A bounded queue gives
+// backpressure: addTask returns false while it is full.
+template <template <typename> class TaskQueue = Container::ThreadSafeStack>
+class BasicThreadPoolImpl : public ThreadPool {
 public:
-  ThreadPoolImpl() : threads_{std::thread::hardware_concurrency()} {
-    shutdown_.store(true);
-  }
+  BasicThreadPoolImpl() : threads_{std::thread::hardware_concurrency()} {}
 
-  ThreadPoolImpl(size_t threads) : threads_{threads} { shutdown_.store(true); }
+  BasicThreadPoolImpl(size_t threads) : threads_{threads} {}
 
-  ~ThreadPoolImpl() override { shutdown(); }
+  // queue_args are forwarded to the TaskQueue constructor, e.g. a capacity
+  template <typename... QueueArgs>
+  BasicThreadPoolImpl(size_t threads, IdlePolicy idle_policy,
+                      QueueArgs &&...queue_args)
+      : tasks_(std::forward<QueueArgs>(queue_args)...),
+        idle_policy_{idle_policy}, threads_{threads} {}
+
+  ~BasicThreadPoolImpl() override { shutdown(); }
+
+  size_t threads() const { return threads_; }
 
   bool start() override {
-    shutdown_.store(false);
-    try {
-      for (size_t i = 0; i < threads_; i++) {
-        workers_.emplace_back(&ThreadPoolImpl::worker, this);
-      }
-    }
-    catch (std::exception& e) {
-      shutdown();
-      return false;
-    }
-    return true;
+    intake_.open();
+    return startWorkers(threads_, [this](size_t) { worker(); });
   }
 
-  void shutdown() override {
-    if (shutdown_.load())
-      return;
-    shutdown_.store(true);
-    for (auto &worker : workers_)
-      worker.join();
+  std::vector<Task> shutdownNow() override {
+    abortAndJoin();
+    intake_.settle();
+    std::vector<Task> pending;
+    Task task;
+    while (tasks_.try_pop(task))
+      pending.push_back(std::move(task));
+    return pending;
   }
 
-  bool addTask(Task const &task) override {
-    if (shutdown_.load())
+  bool addTask(Task const &task) override { return post(task); }
+
+  bool addTask(Task &&task) override { return post(std::move(task)); }
+
+private:
+  template <typename T> bool post(T &&task) {
+    if (!intake_.enter())
       return false;
-    tasks_.push(task);
-    return true;
+    bool pushed = tasks_.try_push(std::forward<T>(task));
+    intake_.leave();
+    if (pushed)
+      idle_.notifyOne();
+    return pushed;
   }
 
-  bool addTask(Task &&task) override {
-    if (shutdown_.load())
-      return false;
-    tasks_.push(std::move(task));
-    return true;
+  void close() override {
+    intake_.close();
+    idle_.notifyAll();
   }
 
-private:
   void worker() {
+    Backoff backoff(idle_policy_);
     while (true) {
-      if (shutdown_.load() && tasks_.empty())
+      if ((intake_.closed() && intake_.quiet() && tasks_.empty()) || aborted())
         break;
       Task task;
       if (tasks_.try_pop(task)) {
+        backoff.reset();
         task();
       } else {
-        std::this_thread::yield();
+        backoff.idle(idle_, [this] { return !tasks_.empty() || intake_.closed(); });
       }
     }
+    workerExited();
   }
 
-  Container::ThreadSafeStack<Task> tasks_;
-  std::atomic<bool> shutdown_;
+  TaskQueue<Task> tasks_;
+  EventCount idle_;
+  IdlePolicy idle_policy_;
+  Intake intake_;
   size_t threads_;
-  std::list<std::thread> workers_;
 };
+
+using ThreadPoolImpl = BasicThreadPoolImpl<>;
 } // namespace v2
 
 namespace v3 {
-class Function{
-  struct AbstractFunction {
-    virtual ~AbstractFunction() {}
-    virtual void operator()() = 0;
-  };
+// Task type of the pool, small captures and packaged_tasks are stored inline.
+using Function = InplaceFunction<64>;
+
+template <template <typename> class TaskQueue = Container::ThreadSafeStack>
+class BasicThreadPoolImpl : public ThreadPool {
 public:
-  template <typename F> struct ConcreteFunction : public AbstractFunction {
-    F f_;
-    ConcreteFunction(F &&f) : f_{std::move(f)} {}
-    void operator()() override { f_(); }
+  BasicThreadPoolImpl() : threads_{std::thread::hardware_concurrency()} {}
+
+  BasicThreadPoolImpl(size_t threads) : threads_{threads} {}
+
+  // queue_args are forwarded to the TaskQueue constructor, e.g. a capacity
+  template <typename... QueueArgs>
+  BasicThreadPoolImpl(size_t threads, IdlePolicy idle_policy,
+                      QueueArgs &&...queue_args)
+      : tasks_(std::forward<QueueArgs>(queue_args)...),
+        idle_policy_{idle_policy}, threads_{threads} {}
+
+  ~BasicThreadPoolImpl() override { shutdown(); }
+
+  size_t threads() const { return threads_; }
+
+  bool start() override {
+    // kept across restarts, a stopped pool has run or handed back their tasks
+    while (states_.size() < threads_)
+      states_.emplace_back(new WorkerState());
+    intake_.open();
+    return startWorkers(threads_, [this](size_t i) { worker(i); });
+  }
+
+  std::vector<Task> shutdownNow() override {
+    abortAndJoin();
+    intake_.settle();
+    std::vector<Task> pending;
+    Function task;
+    for (auto &state : states_) {
+      while (state->inbox_.try_pop(task) || state->local_.pop(task))
+        pending.push_back(toTask(std::move(task)));
+    }
+    while (tasks_.try_pop(task))
+      pending.push_back(toTask(std::move(task)));
+    return pending;
+  }
+
+  bool addTask(Task const &task) override { return post(Function(Task(task))); }
+
+  bool addTask(Task &&task) override { return post(Function(std::move(task))); }
+
+  // Queue a task, a worker queues it on its own local queue without a lock,
+  // where idle and waiting workers may steal it. Returns false and leaves
+  // task untouched if the pool rejects it.
+  bool execute(Function &&task) {
+    // workers may keep queueing while the pool drains during shutdown
+    if (current_pool_ == this) {
+      states_[worker_index_]->local_.push(std::move(task));
+      idle_.notifyOne();
+      return true;
+    }
+    return post(std::move(task));
+  }
+
+  template<typename F>
+  Future<std::invoke_result_t<F>>
+  submit(F&& f) {
+    using ResultType = std::invoke_result_t<F>;
+    Promise<ResultType> promise;
+    Future<ResultType> result = promise.get_future();
+    Function task([promise = std::move(promise),
+                   f = std::forward<F>(f)]() mutable {
+      detail::fulfil(promise, f);
+    });
+    if (!execute(std::move(task)))
+      return {};
+    return result;
+  }
+
+  void runPendingTask() {
+    if (!tryRunPendingTask())
+      std::this_thread::yield();
+  }
+
+  // Keep running pending tasks, local ones first, then stolen ones, until
+  // future is ready. A worker waiting on work it submitted itself must use
+  // this rather than Future::get(), or the pool may run out of threads.
+  // Other threads just block.
+  template <typename T> void waitUntilReady(Future<T> &future) {
+    if (current_pool_ != this) {
+      future.wait();
+      return;
+    }
+    while (!future.ready())
+      runPendingTask();
+  }
+
+  // Run one task from the inbox, the local queue, the shared queue or the
+  // local queue of another worker, returns false if there was none.
+  bool tryRunPendingTask() {
+      Function task;
+      if (current_pool_ == this) {
+        WorkerState &self = *states_[worker_index_];
+        if (self.inbox_.try_pop(task) || self.local_.pop(task)) {
+          task();
+          return true;
+        }
+      }
+      if (tasks_.try_pop(task) || steal(task)) {
+        task();
+        return true;
+      }
+      return false;
+  }
+
+  // Run a copy of f once on every worker. Safe from any thread, workers
+  // included, and never blocks. Returns false and runs nothing unless the
+  // pool is started and not shutting down.
+  bool runOnAllThreads(std::function<void()> f) {
+    if (!intake_.enter())
+      return false;
+    for (auto &state : states_)
+      state->inbox_.push(Function{Task(f)});
+    intake_.leave();
+    idle_.notifyAll();
+    return true;
+  }
+
+private:
+  // Chase-Lev deque of a worker's own tasks. The worker pushes and pops the
+  // newest task without a lock, other threads steal the oldest one. Tasks
+  // are boxed since a thief copies an element before it wins it.
+  class LocalQueue {
+  public:
+    LocalQueue() = default;
+    LocalQueue(LocalQueue const &) = delete;
+    LocalQueue &operator=(LocalQueue const &) = delete;
+
+    ~LocalQueue() {
+      Function *task;
+      while (tasks_.pop(task))
+        delete task;
+    }
+
+    bool empty() const { return tasks_.empty(); }
+
+    // owner only
+    void push(Function &&task) { tasks_.push(new Function(std::move(task))); }
+
+    // owner only
+    bool pop(Function &task) {
+      Function *boxed;
+      return tasks_.pop(boxed) && unbox(boxed, task);
+    }
+
+    // any thread
+    bool steal(Function &task) {
+      Function *boxed;
+      return tasks_.steal(boxed) && unbox(boxed, task);
+    }
+
+  private:
+    static bool unbox(Function *boxed, Function &task) {
+      task = std::move(*boxed);
+      delete boxed;
+      return true;
+    }
+
+    Container::WorkStealingDeque<Function *> tasks_;
   };
-  Function() = default;
-  template <typename F>
-  Function(F&& f): f_{new ConcreteFunction<F>(std::move(f))} {}
-  Function(Function&& other): f_{std::move(other.f_)} {}
-  Function& operator=(Function&& other) {
-    f_ = std::move(other.f_);
-    return *this;
-  }
-  Function(Function const&) = delete;
-  Function& operator=(Function const&) = delete;
-  std::unique_ptr<AbstractFunction> f_;
-  void operator()() { (*f_)(); }
+
+  struct WorkerState {
+    LocalQueue local_;
+    // runOnAllThreads() copies, unbounded so that workers broadcasting to
+    // each other never wait on one another
+    Container::LockFreeQueue<Function> inbox_;
+  };
+
+  // to the shared queue, leaves task untouched if it is rejected
+  bool post(Function &&task) {
+    if (!intake_.enter())
+      return false;
+    bool pushed = tasks_.try_push(std::move(task));
+    intake_.leave();
+    if (pushed)
+      idle_.notifyOne();
+    return pushed;
+  }
+
+  // Take the oldest task of another worker, trying each once starting with
+  // the next one, so thieves spread over their victims.
+  bool steal(Function &task) {
+    size_t n = states_.size();
+    size_t self = current_pool_ == this ? worker_index_ : n - 1;
+    for (size_t i = 1; i <= n; i++) {
+      size_t victim = (self + i) % n;
+      if ((current_pool_ != this || victim != worker_index_) &&
+          states_[victim]->local_.steal(task))
+        return true;
+    }
+    return false;
+  }
+
+  bool stealable() const {
+    for (auto &state : states_) {
+      if (!state->local_.empty())
+        return true;
+    }
+    return false;
+  }
+
+  void close() override {
+    intake_.close();
+    idle_.notifyAll();
+  }
+
+  void worker(size_t index) {
+    current_pool_ = this;
+    worker_index_ = index;
+    WorkerState &self = *states_[index];
+    Backoff backoff(idle_policy_);
+    auto ready = [this, &self] {
+      return !tasks_.empty() || !self.inbox_.empty() || stealable() ||
+             intake_.closed();
+    };
+    while (true) {
+      if ((intake_.closed() && intake_.quiet() && tasks_.empty() &&
+           self.local_.empty() && self.inbox_.empty()) || aborted())
+        break;
+      if (tryRunPendingTask())
+        backoff.reset();
+      else
+        backoff.idle(idle_, ready);
+    }
+    current_pool_ = nullptr;
+    workerExited();
+  }
+
+  TaskQueue<Function> tasks_;
+  EventCount idle_;
+  IdlePolicy idle_policy_;
+  std::vector<std::unique_ptr<WorkerState>> states_;
+  Intake intake_;
+  size_t threads_;
+  static inline thread_local BasicThreadPoolImpl *current_pool_{nullptr};
+  static inline thread_local size_t worker_index_{0};
 };
 
+using ThreadPoolImpl = BasicThreadPoolImpl<>;
+
+} // namespace v3
+
+namespace v4 {
+using Function = v3::Function;
+
+// Work-stealing pool. Each worker owns a Chase-Lev deque: the owner pushes and
+// pops at the bottom, idle workers steal from the top of randomly chosen
+// victims. Submits from outside the pool go to a lock-free injection list that
+// workers drain in batches into their own deque.
+//
+// Workers are spread over the NUMA nodes of the Topology and can be pinned to
+// their CPU. Every node has its own injection list, and an idle worker looks
+// on its own node first: the node's injection list, then the deques of its
+// node mates, and only then the other nodes. Without pinning the split into
+// nodes is nominal.
 class ThreadPoolImpl : public ThreadPool {
+  struct TaskNode {
+    explicit TaskNode(Function &&task) : task_{std::move(task)} {}
+    Function task_;
+    TaskNode *next_{nullptr};
+  };
+
+  class InjectionQueue {
+  public:
+    void push(TaskNode *node) {
+      TaskNode *head = head_.load(std::memory_order_relaxed);
+      do {
+        node->next_ = head;
+      } while (!head_.compare_exchange_weak(head, node,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+    }
+    // detach every queued node, the list is ordered newest first
+    TaskNode *popAll() {
+      if (head_.load(std::memory_order_relaxed) == nullptr)
+        return nullptr;
+      return head_.exchange(nullptr, std::memory_order_acquire);
+    }
+    bool empty() const {
+      return head_.load(std::memory_order_acquire) == nullptr;
+    }
+
+  private:
+    std::atomic<TaskNode *> head_{nullptr};
+  };
+
+  struct WorkerState {
+    Container::WorkStealingDeque<TaskNode *> tasks_;
+    int cpu_{0};
+    size_t node_{0};
+  };
+
+  struct NodeState {
+    InjectionQueue injected_;
+    // indices of the workers placed on this node
+    std::vector<size_t> workers_;
+  };
+
 public:
-  ThreadPoolImpl() : threads_{std::thread::hardware_concurrency()} {
-    shutdown_.store(true);
-  }
+  ThreadPoolImpl() : threads_{std::thread::hardware_concurrency()} {}
 
-  ThreadPoolImpl(size_t threads) : threads_{threads} { shutdown_.store(true); }
+  ThreadPoolImpl(size_t threads) : threads_{threads} {}
 
-  ~ThreadPoolImpl() override { shutdown(); }
+  ThreadPoolImpl(size_t threads, IdlePolicy idle_policy)
+      : idle_policy_{idle_policy}, threads_{threads} {}
+
+  ThreadPoolImpl(size_t threads, IdlePolicy idle_policy, bool pin_workers,
+                 Topology topology = Topology::system())
+      : topology_{std::move(topology)}, idle_policy_{idle_policy},
+        pin_workers_{pin_workers}, threads_{threads} {}
+
+  ~ThreadPoolImpl() override {
+    shutdown();
+    for (auto &state : states_) {
+      TaskNode *node;
+      while (state->tasks_.pop(node))
+        delete node;
+    }
+    for (auto &node : nodes_)
+      deleteList(node->injected_.popAll());
+  }
+
+  size_t threads() const { return threads_; }
 
   bool start() override {
-    thread_local_tasks_.resize(threads_);
-    shutdown_.store(false);
-    try {
-      for (size_t i = 0; i < threads_; i++) {
-        workers_.emplace_back(&ThreadPoolImpl::worker, this);
+    for (size_t i = 0; i < topology_.nodes(); i++)
+      nodes_.emplace_back(new NodeState());
+    std::vector<int> cpus = topology_.interleaved();
+    for (size_t i = 0; i < threads_; i++) {
+      states_.emplace_back(new WorkerState());
+      states_[i]->cpu_ = cpus[i % cpus.size()];
+      states_[i]->node_ = topology_.nodeOf(states_[i]->cpu_);
+      nodes_[states_[i]->node_]->workers_.push_back(i);
+    }
+    intake_.open();
+    return startWorkers(threads_, [this](size_t i) { worker(i); });
+  }
+
+  std::vector<Task> shutdownNow() override {
+    abortAndJoin();
+    intake_.settle();
+    std::vector<Task> pending;
+    for (auto &state : states_) {
+      TaskNode *node;
+      while (state->tasks_.pop(node)) {
+        pending.push_back(toTask(std::move(node->task_)));
+        delete node;
       }
     }
-    catch (std::exception& e) {
-      shutdown();
-      return false;
+    for (auto &node : nodes_)
+      takeList(node->injected_.popAll(), pending);
+    return pending;
+  }
+
+  bool addTask(Task const &task) override { return post(Function(Task(task))); }
+
+  bool addTask(Task &&task) override { return post(Function(std::move(task))); }
+
+  // Returns false and leaves task untouched if the pool rejects it.
+  bool execute(Function &&task) { return post(std::move(task)); }
+
+  template<typename F>
+  Future<std::invoke_result_t<F>>
+  submit(F&& f) {
+    using ResultType = std::invoke_result_t<F>;
+    Promise<ResultType> promise;
+    Future<ResultType> result = promise.get_future();
+    Function task([promise = std::move(promise),
+                   f = std::forward<F>(f)]() mutable {
+      detail::fulfil(promise, f);
+    });
+    if (!post(std::move(task)))
+      return {};
+    return result;
+  }
+
+  // Run f on a worker of node if it has any. The worker may still lose the
+  // task to a thief from another node when its own node is out of work.
+  template<typename F>
+  Future<std::invoke_result_t<F>>
+  submitOnNode(size_t node, F&& f) {
+    using ResultType = std::invoke_result_t<F>;
+    Promise<ResultType> promise;
+    Future<ResultType> result = promise.get_future();
+    Function task([promise = std::move(promise),
+                   f = std::forward<F>(f)]() mutable {
+      detail::fulfil(promise, f);
+    });
+    if (!post(std::move(task), std::min(node, topology_.nodes() - 1)))
+      return {};
+    return result;
+  }
+
+  Topology const &topology() const { return topology_; }
+
+  // Keep running tasks from the local deque, the injection list or a victim
+  // until future is ready. Workers must wait on tasks they submitted this
+  // way; other threads just block.
+  template <typename T> void waitUntilReady(Future<T> &future) {
+    if (current_pool_ != this) {
+      future.wait();
+      return;
+    }
+    while (!future.ready()) {
+      if (!runPendingTask())
+        std::this_thread::yield();
     }
+  }
+
+  // Run one task from the local deque, the injection list or a victim.
+  // Returns false if no task was found.
+  bool runPendingTask() {
+    TaskNode *node = findTask();
+    if (node == nullptr)
+      return false;
+    node->task_();
+    delete node;
     return true;
   }
 
-  void shutdown() override {
-    if (shutdown_.load())
-      return;
-    shutdown_.store(true);
-    for (auto &worker : workers_)
-      worker.join();
+private:
+  // A worker keeps its own tasks, other threads post to the injection list
+  // of the node they run on.
+  bool post(Function &&task) {
+    if (current_pool_ == this)
+      return post(std::move(task), states_[worker_index_]->node_);
+    return post(std::move(task), topology_.currentNode());
   }
 
-  bool addTask(Task const &task) override {
-    if (shutdown_.load())
+  bool post(Function &&task, size_t node) {
+    // workers may keep posting while the pool drains during shutdown, they
+    // run or hand on what they post before they exit
+    bool worker = current_pool_ == this;
+    if (!worker && !intake_.enter())
       return false;
-    tasks_.push(task);
+    TaskNode *task_node = new TaskNode(std::move(task));
+    if (worker && states_[worker_index_]->node_ == node)
+      states_[worker_index_]->tasks_.push(task_node);
+    else
+      nodes_[node]->injected_.push(task_node);
+    if (!worker)
+      intake_.leave();
+    idle_.notifyOne();
     return true;
   }
 
+  void worker(size_t index) {
+    current_pool_ = this;
+    worker_index_ = index;
+    if (pin_workers_)
+      Topology::pinCurrentThread(states_[index]->cpu_);
+    rng_ = static_cast<uint32_t>(index + 1) * 0x9e3779b9u;
+    Backoff backoff(idle_policy_);
+    auto ready = [this] { return hasWork() || intake_.closed(); };
+    while (!aborted()) {
+      if (runPendingTask()) {
+        backoff.reset();
+        continue;
+      }
+      if (intake_.closed() && intake_.quiet() && !hasInjected())
+        break;
+      backoff.idle(idle_, ready);
+    }
+    current_pool_ = nullptr;
+    workerExited();
+  }
+
+  TaskNode *findTask() {
+    if (current_pool_ != this)
+      return steal();
+    WorkerState &self = *states_[worker_index_];
+    TaskNode *node = nullptr;
+    // check the injection list now and then so external tasks do not starve
+    // behind a worker that keeps feeding its own deque
+    if (++tick_ % 61 != 0 && self.tasks_.pop(node))
+      return node;
+    if ((node = takeInjected(self, *nodes_[self.node_])) != nullptr)
+      return node;
+    if (self.tasks_.pop(node))
+      return node;
+    if ((node = steal()) != nullptr)
+      return node;
+    // last resort, nodes without workers or whose workers are all busy
+    for (size_t i = 1; i < nodes_.size(); i++) {
+      NodeState &remote = *nodes_[(self.node_ + i) % nodes_.size()];
+      if ((node = takeInjected(self, remote)) != nullptr)
+        return node;
+    }
+    return nullptr;
+  }
+
+  bool hasInjected() const {
+    for (auto &node : nodes_) {
+      if (!node->injected_.empty())
+        return true;
+    }
+    return false;
+  }
+
+  bool hasWork() const {
+    if (hasInjected())
+      return true;
+    for (auto &state : states_) {
+      if (!state->tasks_.empty())
+        return true;
+    }
+    return false;
+  }
+
+  TaskNode *takeInjected(WorkerState &self, NodeState &from) {
+    TaskNode *node = from.injected_.popAll();
+    if (node == nullptr)
+      return nullptr;
+    // push newest first so the owner pops the oldest task first
+    for (TaskNode *next = node->next_; next != nullptr; ) {
+      TaskNode *temp = next->next_;
+      self.tasks_.push(next);
+      next = temp;
+    }
+    return node;
+  }
+
+  // Try the deques on the caller's node first, then the other nodes in turn.
+  TaskNode *steal() {
+    size_t own = current_pool_ == this ? states_[worker_index_]->node_
+                                       : topology_.currentNode();
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      if (TaskNode *node = stealFrom(nodes_[(own + i) % nodes_.size()]->workers_))
+        return node;
+    }
+    return nullptr;
+  }
+
+  TaskNode *stealFrom(std::vector<size_t> const &victims) {
+    size_t n = victims.size();
+    if (n == 0)
+      return nullptr;
+    size_t start = nextRandom() % n;
+    TaskNode *node = nullptr;
+    for (size_t i = 0; i < n; i++) {
+      size_t victim = victims[(start + i) % n];
+      if ((current_pool_ != this || victim != worker_index_) &&
+          states_[victim]->tasks_.steal(node))
+        return node;
+    }
+    return nullptr;
+  }
+
+
+  static uint32_t nextRandom() {
+    // xorshift32, cheap enough for victim selection
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return rng_;
+  }
+
+  void close() override {
+    intake_.close();
+    idle_.notifyAll();
+  }
+
+  // deletes the nodes of the list and keeps their tasks
+  static void takeList(TaskNode *node, std::vector<Task> &tasks) {
+    while (node != nullptr) {
+      TaskNode *next = node->next_;
+      tasks.push_back(toTask(std::move(node->task_)));
+      delete node;
+      node = next;
+    }
+  }
+
+  static void deleteList(TaskNode *node) {
+    while (node != nullptr) {
+      TaskNode *next = node->next_;
+      delete node;
+      node = next;
+    }
+  }
+
+  Topology topology_{Topology::system()};
+  std::vector<std::unique_ptr<WorkerState>> states_;
+  std::vector<std::unique_ptr<NodeState>> nodes_;
+  EventCount idle_;
+  IdlePolicy idle_policy_;
+  bool pin_workers_{false};
+  Intake intake_;
+  size_t threads_;
+  static inline thread_local ThreadPoolImpl *current_pool_{nullptr};
+  static inline thread_local size_t worker_index_{0};
+  static inline thread_local uint32_t tick_{0};
+  static inline thread_local uint32_t rng_{0x9e3779b9u};
+};
+
+} // namespace v4
+
+namespace v5 {
+// Pool with priority classes, class 0 being the most urgent. Each class gets
+// weight credits per round and a worker takes from the most urgent class
+// that has tasks and credit left, so under load class i runs about
+// weights[i] / sum(weights) of the tasks and low classes cannot starve.
+// Within a class, tasks with a deadline run earliest deadline first, ahead
+// of tasks without one, which run in FIFO order.
+class ThreadPoolImpl : public ThreadPool {
+public:
+  // lock-free snapshot of one class
+  struct ClassStats {
+    size_t depth_;
+    uint64_t executed_;
+    // tasks that started after their deadline
+    uint64_t late_;
+  };
+
+  explicit ThreadPoolImpl(size_t threads = std::thread::hardware_concurrency(),
+                          std::vector<unsigned> weights = {16, 4, 1})
+      : threads_{threads} {
+    for (unsigned weight : weights)
+      lanes_.emplace_back(new Lane(std::max(weight, 1u)));
+    if (lanes_.empty())
+      lanes_.emplace_back(new Lane(1));
+  }
+
+  ~ThreadPoolImpl() override { shutdown(); }
+
+  size_t threads() const { return threads_; }
+
+  bool start() override {
+    shutdown_.store(false);
+    return startWorkers(threads_, [this](size_t) { worker(); });
+  }
+
+  // queued tasks come back most urgent class first
+  std::vector<Task> shutdownNow() override {
+    abortAndJoin();
+    std::vector<Task> pending;
+    for (auto &lane : lanes_) {
+      std::sort_heap(lane->heap_.begin(), lane->heap_.end(), Later());
+      for (auto entry = lane->heap_.rbegin(); entry != lane->heap_.rend(); ++entry)
+        pending.push_back(std::move(entry->task_));
+      lane->heap_.clear();
+      lane->depth_.store(0, std::memory_order_relaxed);
+    }
+    pending_ = 0;
+    return pending;
+  }
+
+  // tasks without a class go to the middle one
+  bool addTask(Task const &task) override {
+    return post(lanes_.size() / 2, Clock::time_point::max(), Task(task));
+  }
+
   bool addTask(Task &&task) override {
-    if (shutdown_.load())
+    return post(lanes_.size() / 2, Clock::time_point::max(), std::move(task));
+  }
+
+  bool addTask(size_t priority, Task task) {
+    return post(priority, Clock::time_point::max(), std::move(task));
+  }
+
+  bool addTask(size_t priority, Clock::time_point deadline, Task task) {
+    return post(priority, deadline, std::move(task));
+  }
+
+  size_t priorities() const { return lanes_.size(); }
+
+  ClassStats stats(size_t priority) const {
+    Lane const &lane = *lanes_[priority];
+    return {lane.depth_.load(std::memory_order_relaxed),
+            lane.executed_.load(std::memory_order_relaxed),
+            lane.late_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  struct Entry {
+    Clock::time_point deadline_;
+    uint64_t seq_;
+    Task task_;
+  };
+
+  // heap order, the top is the earliest deadline, then the oldest task
+  struct Later {
+    bool operator()(Entry const &a, Entry const &b) const {
+      if (a.deadline_ != b.deadline_)
+        return a.deadline_ > b.deadline_;
+      return a.seq_ > b.seq_;
+    }
+  };
+
+  struct Lane {
+    explicit Lane(unsigned weight) : weight_{weight}, credits_{weight} {}
+    // guarded by mtx_
+    std::vector<Entry> heap_;
+    unsigned const weight_;
+    unsigned credits_;
+    std::atomic<size_t> depth_{0};
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> late_{0};
+  };
+
+  bool post(size_t priority, Clock::time_point deadline, Task &&task) {
+    Lane &lane = *lanes_[std::min(priority, lanes_.size() - 1)];
+    {
+      std::lock_guard<std::mutex> lck(mtx_);
+      if (shutdown_.load())
+        return false;
+      lane.heap_.push_back({deadline, seq_++, std::move(task)});
+      std::push_heap(lane.heap_.begin(), lane.heap_.end(), Later());
+      pending_++;
+      // before a worker can pop it, so depth never goes below zero
+      lane.depth_.fetch_add(1, std::memory_order_relaxed);
+    }
+    cv_.notify_one();
+    return true;
+  }
+
+  // the most urgent lane with tasks and credit, requires mtx_ and pending_ > 0
+  Lane &pick() {
+    while (true) {
+      for (auto &lane : lanes_) {
+        if (!lane->heap_.empty() && lane->credits_ > 0) {
+          lane->credits_--;
+          return *lane;
+        }
+      }
+      // every lane with tasks used up its credit, start a new round
+      for (auto &lane : lanes_)
+        lane->credits_ = lane->weight_;
+    }
+  }
+
+  void worker() {
+    while (true) {
+      std::unique_lock<std::mutex> lck(mtx_);
+      cv_.wait(lck, [this] { return pending_ > 0 || shutdown_.load(); });
+      if (pending_ == 0 || aborted())
+        break;
+      Lane &lane = pick();
+      std::pop_heap(lane.heap_.begin(), lane.heap_.end(), Later());
+      Entry entry = std::move(lane.heap_.back());
+      lane.heap_.pop_back();
+      pending_--;
+      lck.unlock();
+      lane.depth_.fetch_sub(1, std::memory_order_relaxed);
+      if (entry.deadline_ != Clock::time_point::max() &&
+          Clock::now() > entry.deadline_)
+        lane.late_.fetch_add(1, std::memory_order_relaxed);
+      entry.task_();
+      lane.executed_.fetch_add(1, std::memory_order_relaxed);
+    }
+    workerExited();
+  }
+
+  void close() override {
+    {
+      std::lock_guard<std::mutex> lck(mtx_);
+      shutdown_.store(true);
+    }
+    cv_.notify_all();
+  }
+
+  std::vector<std::unique_ptr<Lane>> lanes_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  size_t pending_{0};
+  uint64_t seq_{0};
+  std::atomic<bool> shutdown_{true};
+  size_t threads_;
+};
+} // namespace v5
+
+namespace v6 {
+class ScopedBlocking;
+
+// Elastic pool that runs between min_threads and max_threads workers. It
+// adds a worker when the oldest queued task has waited longer than
+// max_latency, or when a worker enters a ScopedBlocking section while tasks
+// are waiting, so a burst of blocking tasks does not starve the rest. A
+// worker that found nothing to do for keep_alive retires as long as more
+// than min_threads are left. A housekeeping thread watches the queue and
+// joins retired workers.
+class ThreadPoolImpl : public ThreadPool {
+public:
+  using Function = InplaceFunction<64>;
+
+  explicit ThreadPoolImpl(
+      size_t min_threads = 1,
+      size_t max_threads = std::thread::hardware_concurrency(),
+      Clock::duration keep_alive = std::chrono::seconds(10),
+      Clock::duration max_latency = std::chrono::milliseconds(10))
+      : min_threads_{min_threads},
+        max_threads_{std::max<size_t>(std::max<size_t>(max_threads, min_threads), 1)},
+        keep_alive_{keep_alive}, max_latency_{max_latency} {}
+
+  ~ThreadPoolImpl() override { shutdown(); }
+
+  bool start() override {
+    std::lock_guard<std::mutex> lck(mtx_);
+    shutdown_.store(false);
+    try {
+      monitor_ = std::thread(&ThreadPoolImpl::monitor, this);
+    } catch (std::exception &e) {
+      shutdown_.store(true);
       return false;
-    tasks_.push(std::move(task));
+    }
+    for (size_t i = 0; i < min_threads_; i++)
+      spawn();
     return true;
   }
 
+  std::vector<Task> shutdownNow() override {
+    abortAndJoin();
+    std::vector<Task> pending;
+    for (auto &entry : queue_)
+      pending.push_back(toTask(std::move(entry.task_)));
+    queue_.clear();
+    return pending;
+  }
+
+  bool addTask(Task const &task) override { return post(Function(task)); }
+
+  bool addTask(Task &&task) override { return post(Function(std::move(task))); }
+
+  // Leaves task untouched if it is rejected.
+  bool execute(Function &&task) { return post(std::move(task)); }
+
   template<typename F>
-  std::future<typename std::result_of<F()>::type> 
-  submit(F const& f) {
-    using ResultType = typename std::result_of<F()>::type;
-    if (shutdown_.load()) return {};
-    std::packaged_task<ResultType()> task(std::move(f));
-    std::future<ResultType> result(task.get_future());
-    if (thread_id_ >= 0) {
-      thread_local_tasks_[thread_id_].push_back(std::move(task));
-    }
-    else {
-      tasks_.push(std::move(task));
-    }
+  Future<std::invoke_result_t<F>>
+  submit(F&& f) {
+    using ResultType = std::invoke_result_t<F>;
+    Promise<ResultType> promise;
+    Future<ResultType> result = promise.get_future();
+    Function task([promise = std::move(promise),
+                   f = std::forward<F>(f)]() mutable {
+      detail::fulfil(promise, f);
+    });
+    if (!post(std::move(task)))
+      return {};
     return result;
   }
 
-  template<typename F>
-  std::future<typename std::result_of<F()>::type> 
-  submit(F && f) {
-    using ResultType = typename std::result_of<F()>::type;
-    std::packaged_task<ResultType()> task(std::move(f));
-    std::future<ResultType> result(task.get_future());
-    if (thread_id_ >= 0) {
-      thread_local_tasks_[thread_id_].push_back(std::move(task));
+  // live workers, blocked ones included
+  size_t threads() const {
+    std::lock_guard<std::mutex> lck(mtx_);
+    return threads_;
+  }
+
+private:
+  friend class ScopedBlocking;
+
+  struct Entry {
+    Clock::time_point enqueued_;
+    Function task_;
+  };
+
+  bool post(Function &&task) {
+    {
+      std::lock_guard<std::mutex> lck(mtx_);
+      if (shutdown_.load())
+        return false;
+      queue_.push_back({Clock::now(), std::move(task)});
+      if (queue_.size() == 1)
+        monitor_cv_.notify_one();
+      if (idle_ == 0 && running() < std::max<size_t>(min_threads_, 1))
+        spawn();
     }
-    else {
-      tasks_.push(std::move(task));
+    cv_.notify_one();
+    return true;
+  }
+
+  size_t running() const { return threads_ - blocked_; }
+
+  void close() override {
+    {
+      std::lock_guard<std::mutex> lck(mtx_);
+      shutdown_.store(true);
     }
-    return result;
+    cv_.notify_all();
+    monitor_cv_.notify_one();
   }
 
-  void runPendingTask() {
-      Function task;
-      if (thread_id_ >= 0 && !thread_local_tasks_[thread_id_].empty()) {
-        task = std::move(thread_local_tasks_[thread_id_].front());
-        thread_local_tasks_[thread_id_].pop_front();
-        task();
-      }
-      else if (tasks_.try_pop(task)) {
-        task();
-      } else {
-        std::this_thread::yield();
+  void join() override {
+    if (monitor_.joinable())
+      monitor_.join();
+    // draining tasks may still block and add workers
+    while (true) {
+      std::list<std::thread> threads;
+      {
+        std::lock_guard<std::mutex> lck(mtx_);
+        threads.splice(threads.end(), workers_);
+        threads.splice(threads.end(), exited_);
       }
+      if (threads.empty())
+        break;
+      for (auto &thread : threads)
+        thread.join();
+    }
   }
 
-  void runOnAllThreads(std::function<void()> f) {
-    for (size_t i = 0; i < threads_; i++) {
-      std::function<void()> temp = f;
-      thread_local_tasks_[i].emplace_back(std::move(temp));
+  // requires mtx_, does nothing at max_threads
+  void spawn() {
+    if (threads_ >= max_threads_)
+      return;
+    workers_.emplace_back();
+    if (!spawnWorker(workers_.back(), &ThreadPoolImpl::worker, this,
+                     std::prev(workers_.end()))) {
+      workers_.pop_back();
+      return;
     }
+    threads_++;
   }
 
-private:
-  void worker() {
-    thread_id_ = cur_id_++;
+  void enterBlocking() {
+    std::lock_guard<std::mutex> lck(mtx_);
+    blocked_++;
+    // hand the waiting tasks to a new worker instead of this one
+    if (idle_ == 0 && (!queue_.empty() || running() < min_threads_))
+      spawn();
+  }
+
+  void exitBlocking() {
+    std::lock_guard<std::mutex> lck(mtx_);
+    blocked_--;
+  }
+
+  void worker(std::list<std::thread>::iterator self) {
+    current_pool_ = this;
+    std::unique_lock<std::mutex> lck(mtx_);
     while (true) {
-      if (shutdown_.load() && tasks_.empty() && thread_local_tasks_[thread_id_].empty())
+      if (aborted())
         break;
-      runPendingTask();
+      if (queue_.empty()) {
+        if (shutdown_.load())
+          break;
+        idle_++;
+        bool woken = cv_.wait_for(lck, keep_alive_, [this] {
+          return !queue_.empty() || shutdown_.load();
+        });
+        idle_--;
+        if (!woken && threads_ > min_threads_) {
+          // the spawning thread assigned *self under mtx_
+          exited_.splice(exited_.end(), workers_, self);
+          monitor_cv_.notify_one();
+          break;
+        }
+        continue;
+      }
+      Entry entry = std::move(queue_.front());
+      queue_.pop_front();
+      lck.unlock();
+      entry.task_();
+      lck.lock();
     }
+    threads_--;
+    current_pool_ = nullptr;
+    workerExited();
   }
 
-  Container::ThreadSafeStack<Function> tasks_;
-  std::vector<std::list<Function>> thread_local_tasks_;
-  static thread_local int thread_id_;
-  std::atomic<bool> shutdown_;
-  int cur_id_ = 0;
-  size_t threads_;
-  std::list<std::thread> workers_;
+  // Adds a worker while the oldest task waits too long and joins retired
+  // workers, sleeps while the queue is empty.
+  void monitor() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    while (!shutdown_.load()) {
+      if (!exited_.empty()) {
+        std::list<std::thread> exited;
+        exited.swap(exited_);
+        lck.unlock();
+        for (auto &thread : exited)
+          thread.join();
+        lck.lock();
+        continue;
+      }
+      if (queue_.empty()) {
+        monitor_cv_.wait(lck, [this] {
+          return shutdown_.load() || !queue_.empty() || !exited_.empty();
+        });
+        continue;
+      }
+      Clock::time_point oldest = queue_.front().enqueued_;
+      if (Clock::now() - oldest >= max_latency_) {
+        spawn();
+        oldest = Clock::now();
+      }
+      monitor_cv_.wait_until(lck, oldest + max_latency_);
+    }
+  }
+
+  size_t const min_threads_;
+  size_t const max_threads_;
+  Clock::duration const keep_alive_;
+  Clock::duration const max_latency_;
+  mutable std::mutex mtx_;
+  std::condition_variable cv_;
+  std::condition_variable monitor_cv_;
+  std::deque<Entry> queue_;
+  // counts guarded by mtx_
+  size_t threads_{0};
+  size_t idle_{0};
+  size_t blocked_{0};
+  std::atomic<bool> shutdown_{true};
+  // retired workers waiting to be joined, the live ones are in workers_;
+  // both guarded by mtx_
+  std::list<std::thread> exited_;
+  std::thread monitor_;
+  static inline thread_local ThreadPoolImpl *current_pool_{nullptr};
 };
 
-thread_local int ThreadPoolImpl::thread_id_{-1};
+// Marks the calling task as blocked, e.g. on I/O or a lock, for as long as
+// it lives. On a worker of an elastic pool the pool may start another worker
+// to keep the queue moving; anywhere else it does nothing.
+class ScopedBlocking {
+public:
+  ScopedBlocking() : pool_{ThreadPoolImpl::current_pool_} {
+    if (pool_ != nullptr)
+      pool_->enterBlocking();
+  }
+
+  ~ScopedBlocking() {
+    if (pool_ != nullptr)
+      pool_->exitBlocking();
+  }
 
-} // namespace v3
+  ScopedBlocking(ScopedBlocking const &) = delete;
+  ScopedBlocking &operator=(ScopedBlocking const &) = delete;
+
+private:
+  ThreadPoolImpl *pool_;
+};
+} // namespace v6
 
 using namespace v1;
 
 } // namespace Thread
+
+#endif
@@ -1,21 +1,34 @@
 #ifndef THREADSAFESTACK
 #define THREADSAFESTACK
 
+#include "reclamation.h"
 #include <cassert>
 #include <condition_variable>
 #include <functional>
+#include <iterator>
 #include <iostream>
 #include <list>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <stack>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <optional>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace Container {
 
+constexpr size_t kCacheLineSize = 64;
+
 template <typename T> class ThreadSafeStack {
 public:
   ThreadSafeStack() = default;
@@ -31,6 +44,17 @@ public:
     cv_.notify_one();
   }
 
+  // the stack is unbounded, so these never fail
+  bool try_push(T &&t) {
+    push(std::move(t));
+    return true;
+  }
+
+  bool try_push(T const &t) {
+    push(t);
+    return true;
+  }
+
   std::unique_ptr<T> blocking_pop() {
     std::unique_lock<std::mutex> lck;
     cv_.wait(lck, [this] { return !empty(); });
@@ -149,113 +173,1285 @@ private:
   Node *tail_;
 };
 
-template <typename Key, typename Value> class ThreadSafeHashMap {
+// Lock-free Treiber stack. The head carries a modification tag next to the
+// pointer to defeat ABA, and nodes are recycled through the stack's own
+// free-list instead of being deleted, so a racing pop may read next_ of a node
+// that was already taken without touching freed memory. The cached nodes are
+// freed with the stack.
+template <typename T> class LockFreeStack {
 public:
-  ThreadSafeHashMap() : bucket_cnt_{19} { buckets_ = new Bucket[bucket_cnt_]; }
+  LockFreeStack() = default;
+
+  ~LockFreeStack() {
+    Node *node = Tagged::pointer(head_.load(std::memory_order_relaxed));
+    while (node != nullptr) {
+      Node *next = node->next_.load(std::memory_order_relaxed);
+      node->destroy();
+      delete node;
+      node = next;
+    }
+  }
+
+  LockFreeStack(LockFreeStack const &) = delete;
+  LockFreeStack &operator=(LockFreeStack const &) = delete;
+
+  void push(T const &t) {
+    Node *node = allocate(t);
+    link(node, node);
+  }
+
+  void push(T &&t) {
+    Node *node = allocate(std::move(t));
+    link(node, node);
+  }
+
+  // the stack is unbounded, so these never fail
+  bool try_push(T const &t) {
+    push(t);
+    return true;
+  }
+
+  bool try_push(T &&t) {
+    push(std::move(t));
+    return true;
+  }
+
+  // Push every element of [first, last) with a single CAS, the last element
+  // ends up on top.
+  template <typename InputIt> void push_range(InputIt first, InputIt last) {
+    if (first == last)
+      return;
+    Node *bottom = allocate(*first);
+    Node *top = bottom;
+    for (++first; first != last; ++first) {
+      Node *node = allocate(*first);
+      node->next_.store(top, std::memory_order_relaxed);
+      top = node;
+    }
+    link(top, bottom);
+  }
+
+  bool try_pop(T &t) {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (true) {
+      Node *node = Tagged::pointer(head);
+      if (node == nullptr)
+        return false;
+      Node *next = node->next_.load(std::memory_order_relaxed);
+      if (head_.compare_exchange_weak(
+              head, Tagged::pack(next, Tagged::tag(head) + 1),
+              std::memory_order_acquire, std::memory_order_acquire)) {
+        t = std::move(*node->data());
+        node->destroy();
+        free_.push(node);
+        return true;
+      }
+    }
+  }
+
+  std::unique_ptr<T> try_pop() {
+    std::unique_ptr<T> t;
+    T temp;
+    if (try_pop(temp))
+      t = std::make_unique<T>(std::move(temp));
+    return t;
+  }
+
+  // Detach the whole stack with a single CAS and move its elements to out,
+  // top first. Returns how many elements were popped.
+  template <typename OutputIt> size_t pop_all(OutputIt out) {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (Tagged::pointer(head) != nullptr &&
+           !head_.compare_exchange_weak(
+               head, Tagged::pack(nullptr, Tagged::tag(head) + 1),
+               std::memory_order_acquire, std::memory_order_acquire))
+      ;
+    size_t n = 0;
+    for (Node *node = Tagged::pointer(head); node != nullptr; n++) {
+      Node *next = node->next_.load(std::memory_order_relaxed);
+      *out++ = std::move(*node->data());
+      node->destroy();
+      free_.push(node);
+      node = next;
+    }
+    return n;
+  }
+
+  bool empty() const {
+    return Tagged::pointer(head_.load(std::memory_order_acquire)) == nullptr;
+  }
+
+private:
+  struct Node {
+    T *data() { return reinterpret_cast<T *>(&storage_); }
+    void destroy() { data()->~T(); }
+    std::atomic<Node *> next_{nullptr};
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+  };
+  using Tagged = TaggedPointer<Node>;
+
+  template <typename U> Node *allocate(U &&u) {
+    Node *node = free_.pop();
+    if (node == nullptr)
+      node = new Node();
+    node->next_.store(nullptr, std::memory_order_relaxed);
+    new (&node->storage_) T(std::forward<U>(u));
+    return node;
+  }
+
+  // splice the chain top..bottom on top of the stack
+  void link(Node *top, Node *bottom) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    do {
+      bottom->next_.store(Tagged::pointer(head), std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(
+        head, Tagged::pack(top, Tagged::tag(head) + 1),
+        std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  std::atomic<uint64_t> head_{0};
+  FreeList<Node> free_;
+};
+
+// Unbounded lock-free Michael-Scott queue. Producers only touch the tail and
+// consumers only the head, so they never contend on a lock. Popped nodes are
+// handed to the Reclaimer (HazardPointers or EpochReclamation) and recycled
+// through the queue's own free-list once no other thread can reach them, so
+// steady-state push/pop does not call the global allocator.
+template <typename T, typename Reclaimer = HazardPointers> class LockFreeQueue {
+public:
+  LockFreeQueue() : cache_{new NodeCache()} {
+    Node *dummy = allocate();
+    head_.store(dummy, std::memory_order_relaxed);
+    tail_.store(dummy, std::memory_order_relaxed);
+  }
+
+  ~LockFreeQueue() {
+    Node *node = head_.load(std::memory_order_relaxed);
+    Node *next = node->next_.load(std::memory_order_relaxed);
+    delete node;
+    while (next != nullptr) {
+      node = next;
+      next = node->next_.load(std::memory_order_relaxed);
+      node->destroy();
+      delete node;
+    }
+    // nodes still waiting in the Reclaimer go once the last one is recycled
+    cache_->free_.clear();
+    cache_->release();
+  }
+
+  LockFreeQueue(LockFreeQueue const &) = delete;
+  LockFreeQueue &operator=(LockFreeQueue const &) = delete;
+
+  void push(T const &t) { enqueue(allocate(t)); }
+
+  void push(T &&t) { enqueue(allocate(std::move(t))); }
+
+  // the queue is unbounded, so these never fail
+  bool try_push(T const &t) {
+    push(t);
+    return true;
+  }
+
+  bool try_push(T &&t) {
+    push(std::move(t));
+    return true;
+  }
+
+  bool try_pop(T &t) {
+    typename Reclaimer::Guard guard;
+    while (true) {
+      Node *head = guard.protect(0, head_);
+      Node *tail = tail_.load(std::memory_order_acquire);
+      Node *next = guard.protect(1, head->next_);
+      if (head != head_.load(std::memory_order_acquire))
+        continue;
+      if (next == nullptr)
+        return false;
+      if (head == tail) {
+        // tail is lagging behind, help the producer that linked next
+        tail_.compare_exchange_strong(tail, next, std::memory_order_release,
+                                      std::memory_order_relaxed);
+        continue;
+      }
+      if (head_.compare_exchange_strong(head, next, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+        // next is the new dummy; the guard keeps it alive while we move the
+        // value out even if another consumer retires it right away
+        t = std::move(*next->data());
+        next->destroy();
+        guard.reset(0);
+        cache_->refs_.fetch_add(1, std::memory_order_relaxed);
+        Reclaimer::retire(head, &LockFreeQueue::recycle);
+        return true;
+      }
+    }
+  }
+
+  std::unique_ptr<T> try_pop() {
+    std::unique_ptr<T> t;
+    T temp;
+    if (try_pop(temp))
+      t = std::make_unique<T>(std::move(temp));
+    return t;
+  }
+
+  bool empty() {
+    typename Reclaimer::Guard guard;
+    Node *head = guard.protect(0, head_);
+    return head->next_.load(std::memory_order_acquire) == nullptr;
+  }
+
+private:
+  struct NodeCache;
+
+  struct Node {
+    T *data() { return reinterpret_cast<T *>(&storage_); }
+    void destroy() { data()->~T(); }
+    std::atomic<Node *> next_{nullptr};
+    NodeCache *cache_{nullptr};
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+  };
+
+  // Free-list of one queue. A retired node may be recycled after its queue is
+  // gone, so the queue and every node waiting in the Reclaimer hold a
+  // reference and the last one deletes the cache with the nodes in it.
+  struct NodeCache {
+    void release() {
+      if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+    }
+    FreeList<Node> free_;
+    std::atomic<size_t> refs_{1};
+  };
+
+  void enqueue(Node *node) {
+    typename Reclaimer::Guard guard;
+    while (true) {
+      Node *tail = guard.protect(0, tail_);
+      Node *next = tail->next_.load(std::memory_order_acquire);
+      if (tail != tail_.load(std::memory_order_acquire))
+        continue;
+      if (next != nullptr) {
+        tail_.compare_exchange_strong(tail, next, std::memory_order_release,
+                                      std::memory_order_relaxed);
+        continue;
+      }
+      if (tail->next_.compare_exchange_weak(next, node,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        tail_.compare_exchange_strong(tail, node, std::memory_order_release,
+                                      std::memory_order_relaxed);
+        return;
+      }
+    }
+  }
+
+  template <typename... Args> Node *allocate(Args &&...args) {
+    Node *node = cache_->free_.pop();
+    if (node == nullptr) {
+      node = new Node();
+      node->cache_ = cache_;
+    }
+    node->next_.store(nullptr, std::memory_order_relaxed);
+    if constexpr (sizeof...(Args) > 0)
+      new (&node->storage_) T(std::forward<Args>(args)...);
+    return node;
+  }
+
+  static void recycle(void *ptr) {
+    Node *node = static_cast<Node *>(ptr);
+    NodeCache *cache = node->cache_;
+    cache->free_.push(node);
+    cache->release();
+  }
+
+  NodeCache *cache_;
+  alignas(kCacheLineSize) std::atomic<Node *> head_;
+  alignas(kCacheLineSize) std::atomic<Node *> tail_;
+};
+
+// Fixed-capacity lock-free MPMC queue (Vyukov). Every cell carries a sequence
+// number telling producers and consumers whose turn it is, so push and pop
+// each take a single CAS on their own index and never allocate.
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity = 1024)
+      : mask_{roundUpToPowerOfTwo(capacity) - 1}, cells_{new Cell[mask_ + 1]} {
+    for (size_t i = 0; i <= mask_; i++)
+      cells_[i].sequence_.store(i, std::memory_order_relaxed);
+  }
+
+  ~BoundedQueue() {
+    size_t push_pos = push_pos_.load(std::memory_order_relaxed);
+    for (size_t pos = pop_pos_.load(std::memory_order_relaxed); pos != push_pos;
+         pos++)
+      cells_[pos & mask_].take();
+  }
+
+  BoundedQueue(BoundedQueue const &) = delete;
+  BoundedQueue &operator=(BoundedQueue const &) = delete;
+
+  bool try_push(T &&t) {
+    size_t pos;
+    Cell *cell = claim(push_pos_, 0, pos);
+    if (cell == nullptr)
+      return false;
+    cell->construct(std::move(t));
+    cell->sequence_.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_push(T const &t) {
+    T copy(t);
+    return try_push(std::move(copy));
+  }
+
+  // blocks while the queue is full
+  void push(T &&t) {
+    while (!try_push(std::move(t)))
+      std::this_thread::yield();
+  }
+
+  void push(T const &t) {
+    T copy(t);
+    push(std::move(copy));
+  }
+
+  bool try_pop(T &t) {
+    size_t pos;
+    Cell *cell = claim(pop_pos_, 1, pos);
+    if (cell == nullptr)
+      return false;
+    t = cell->take();
+    cell->sequence_.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Move as many elements of [first, last) as fit with a single CAS, returns
+  // how many were pushed.
+  template <typename InputIt> size_t push_bulk(InputIt first, InputIt last) {
+    size_t want = std::distance(first, last);
+    size_t pos;
+    size_t n = claimRange(push_pos_, 0, want, pos);
+    for (size_t i = 0; i < n; i++, ++first) {
+      Cell &cell = cells_[(pos + i) & mask_];
+      cell.construct(std::move(*first));
+      cell.sequence_.store(pos + i + 1, std::memory_order_release);
+    }
+    return n;
+  }
+
+  // Pop up to max elements into out with a single CAS, returns how many were
+  // popped.
+  template <typename OutputIt> size_t pop_bulk(OutputIt out, size_t max) {
+    size_t pos;
+    size_t n = claimRange(pop_pos_, 1, max, pos);
+    for (size_t i = 0; i < n; i++) {
+      Cell &cell = cells_[(pos + i) & mask_];
+      *out++ = cell.take();
+      cell.sequence_.store(pos + i + mask_ + 1, std::memory_order_release);
+    }
+    return n;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  size_t size() const {
+    size_t pop_pos = pop_pos_.load(std::memory_order_relaxed);
+    size_t push_pos = push_pos_.load(std::memory_order_relaxed);
+    return push_pos > pop_pos ? push_pos - pop_pos : 0;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+private:
+  struct alignas(kCacheLineSize) Cell {
+    template <typename U> void construct(U &&u) {
+      new (&storage_) T(std::forward<U>(u));
+    }
+    T take() {
+      T *data = reinterpret_cast<T *>(&storage_);
+      T t(std::move(*data));
+      data->~T();
+      return t;
+    }
+    std::atomic<size_t> sequence_;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+  };
+
+  // A cell at position pos is ready for producers when its sequence equals
+  // pos and for consumers when it equals pos + 1.
+  Cell *claim(std::atomic<size_t> &index, size_t lag, size_t &pos) {
+    pos = index.load(std::memory_order_relaxed);
+    while (true) {
+      Cell *cell = &cells_[pos & mask_];
+      size_t sequence = cell->sequence_.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) -
+                      static_cast<intptr_t>(pos + lag);
+      if (diff == 0) {
+        if (index.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          return cell;
+      } else if (diff < 0) {
+        return nullptr;
+      } else {
+        pos = index.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  size_t claimRange(std::atomic<size_t> &index, size_t lag, size_t want,
+                    size_t &pos) {
+    pos = index.load(std::memory_order_relaxed);
+    while (want > 0) {
+      size_t ready = 0;
+      while (ready < want && ready <= mask_ &&
+             cells_[(pos + ready) & mask_].sequence_.load(
+                 std::memory_order_acquire) == pos + ready + lag)
+        ready++;
+      if (ready == 0) {
+        size_t current = index.load(std::memory_order_relaxed);
+        if (current == pos)
+          return 0;
+        pos = current;
+        continue;
+      }
+      if (index.compare_exchange_weak(pos, pos + ready,
+                                      std::memory_order_relaxed))
+        return ready;
+    }
+    return 0;
+  }
+
+  static size_t roundUpToPowerOfTwo(size_t n) {
+    size_t capacity = 2;
+    while (capacity < n)
+      capacity <<= 1;
+    return capacity;
+  }
+
+  size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(kCacheLineSize) std::atomic<size_t> push_pos_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> pop_pos_{0};
+};
+
+// Chase-Lev work-stealing deque. The owning thread pushes and pops at the
+// bottom, any other thread may steal from the top. Elements must be trivially
+// copyable (typically pointers); the circular array grows on demand and
+// retired arrays are kept alive until the deque is destroyed, since a thief
+// may still be reading from them.
+template <typename T> class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "WorkStealingDeque requires a trivially copyable element");
+
+public:
+  explicit WorkStealingDeque(size_t capacity = 256)
+      : array_{new Array(roundUpToPowerOfTwo(capacity))} {}
+
+  ~WorkStealingDeque() { delete array_.load(std::memory_order_relaxed); }
+
+  WorkStealingDeque(WorkStealingDeque const &) = delete;
+  WorkStealingDeque &operator=(WorkStealingDeque const &) = delete;
+
+  // owner only
+  void push(T t) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Array *array = array_.load(std::memory_order_relaxed);
+    if (bottom - top > static_cast<int64_t>(array->mask_)) {
+      Array *bigger = array->grow(top, bottom);
+      retired_.emplace_back(array);
+      array_.store(bigger, std::memory_order_release);
+      array = bigger;
+    }
+    array->put(bottom, t);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // owner only
+  bool pop(T &t) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Array *array = array_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+    t = array->get(bottom);
+    if (top == bottom) {
+      // last element, race against thieves for it
+      bool won = top_.compare_exchange_strong(top, top + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
 
-  ThreadSafeHashMap(size_t bucket_cnt) : bucket_cnt_{bucket_cnt} {
-    buckets_ = new Bucket[bucket_cnt_];
+  // any thread, returns false if the deque is empty or another thief won
+  bool steal(T &t) {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom)
+      return false;
+    Array *array = array_.load(std::memory_order_acquire);
+    T stolen = array->get(top);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+      return false;
+    t = stolen;
+    return true;
   }
+
+  bool empty() const { return size() == 0; }
+
+  size_t size() const {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+  }
+
+private:
+  struct Array {
+    explicit Array(size_t capacity)
+        : mask_{capacity - 1}, data_{new std::atomic<T>[capacity]} {}
+    T get(int64_t i) const {
+      return data_[i & mask_].load(std::memory_order_relaxed);
+    }
+    void put(int64_t i, T t) {
+      data_[i & mask_].store(t, std::memory_order_relaxed);
+    }
+    Array *grow(int64_t top, int64_t bottom) const {
+      Array *bigger = new Array(2 * (mask_ + 1));
+      for (int64_t i = top; i < bottom; i++)
+        bigger->put(i, get(i));
+      return bigger;
+    }
+    size_t mask_;
+    std::unique_ptr<std::atomic<T>[]> data_;
+  };
+
+  static size_t roundUpToPowerOfTwo(size_t n) {
+    size_t capacity = 2;
+    while (capacity < n)
+      capacity <<= 1;
+    return capacity;
+  }
+
+  alignas(kCacheLineSize) std::atomic<int64_t> top_{0};
+  alignas(kCacheLineSize) std::atomic<int64_t> bottom_{0};
+  std::atomic<Array *> array_;
+  std::vector<std::unique_ptr<Array>> retired_;
+};
+
+// Resizing is incremental: a resize links a new table behind the current one,
+// and every put/erase then migrates a few buckets until the old table is empty
+// and can be retired. A bucket that has been migrated is marked, so any
+// operation that lands on it moves on to the next table. Tables are retired
+// through EpochReclamation since a concurrent operation may still hold one.
+//
+// Reads take no lock and write no shared memory. A bucket is a singly linked
+// list of immutable nodes: writers serialise on the bucket mutex and publish a
+// fresh node instead of modifying one in place, and replaced or erased nodes
+// are retired through EpochReclamation, so get only pins the epoch and follows
+// pointers.
+template <typename Key, typename Value> class ThreadSafeHashMap {
+public:
+  ThreadSafeHashMap() : table_{new Table(19)} {}
+
+  ThreadSafeHashMap(size_t bucket_cnt) : table_{new Table(bucket_cnt)} {}
+
   ~ThreadSafeHashMap() {
-    delete [] buckets_;
+    Table *table = table_.load();
+    while (table != nullptr) {
+      Table *next = table->next_.load();
+      delete table;
+      table = next;
+    }
   }
-  int getBucketId(Key const &key) { return std::hash<Key>{}(key); }
+
+  size_t getBucketId(Key const &key) { return std::hash<Key>{}(key); }
 
   void put(Key const &key, Value const &value) {
-    std::shared_lock<std::shared_timed_mutex> shared_lock(mtx_);
-    int idx = getBucketId(key) % bucket_cnt_;
-    if (buckets_[idx].put(key, value))
-      size_++;
-    if (size_ > 50 && size_  > 10 * bucket_cnt_) {
-      shared_lock.unlock();
-      resize(size_ / 3);
-    }
+    EpochReclamation::Guard guard;
+    withBucket(getBucketId(key), [&](Bucket &bucket) {
+      if (bucket.put(key, value))
+        size_++;
+    });
+    afterWrite();
   }
 
   void erase(Key const &key) {
-    std::shared_lock<std::shared_timed_mutex> shared_lock(mtx_);
-    int idx = getBucketId(key) % bucket_cnt_;
-    if (buckets_[idx].erase(key))
-      size_--;
-    if (size_ > 50 && size_ < 5 * bucket_cnt_) {
-      shared_lock.unlock();
-      resize(size_ / 3);
+    EpochReclamation::Guard guard;
+    withBucket(getBucketId(key), [&](Bucket &bucket) {
+      if (bucket.erase(key))
+        size_--;
+    });
+    afterWrite();
+  }
+
+  std::optional<Value> get(Key const &key) {
+    EpochReclamation::Guard guard;
+    size_t hash = getBucketId(key);
+    for (Table *table = guard.protect(0, table_);;
+         table = table->next_.load(std::memory_order_acquire)) {
+      Bucket &bucket = table->bucketOf(hash);
+      // a bucket migrated after this check still holds the pairs it had at
+      // migration time, which is a valid result for a concurrent read
+      if (!bucket.migrated_.load(std::memory_order_acquire))
+        return bucket.get(key);
     }
   }
 
-  Value get(Key const &key) {
-    std::shared_lock<std::shared_timed_mutex> shared_lock(mtx_);
-    int idx = getBucketId(key) % bucket_cnt_;
-    return buckets_[idx].get(key);
+  // Look up every key under a single epoch guard, visiting them bucket by
+  // bucket. The result is in the order of keys.
+  std::vector<std::optional<Value>> multi_get(std::vector<Key> const &keys) {
+    EpochReclamation::Guard guard;
+    std::vector<size_t> hashes = hashesOf(keys);
+    std::vector<std::optional<Value>> values(keys.size());
+    Table *head = table_.load(std::memory_order_acquire);
+    for (size_t i : groupByBucket(hashes, head)) {
+      for (Table *table = head;;
+           table = table->next_.load(std::memory_order_acquire)) {
+        Bucket &bucket = table->bucketOf(hashes[i]);
+        if (!bucket.migrated_.load(std::memory_order_acquire)) {
+          values[i] = bucket.get(keys[i]);
+          break;
+        }
+      }
+    }
+    return values;
   }
 
-  void resize(int bucket_cnt) {
-    std::unique_lock<std::shared_timed_mutex> exclusive_lock(mtx_);
-    Bucket* buckets = new Bucket[bucket_cnt];
-    for (int i = 0; i < bucket_cnt_; i++) {
-      for (auto& kv: buckets_[i].kvs_) {
-        int idx = getBucketId(kv.first) % bucket_cnt;
-        buckets[idx].put(kv.first, kv.second);
+  // Insert or update every pair, taking each bucket mutex once.
+  void multi_put(std::vector<std::pair<Key, Value>> const &kvs) {
+    EpochReclamation::Guard guard;
+    std::vector<size_t> hashes(kvs.size());
+    for (size_t i = 0; i < kvs.size(); i++)
+      hashes[i] = getBucketId(kvs[i].first);
+    withBuckets(hashes, [&](Bucket &bucket, size_t i) {
+      if (bucket.put(kvs[i].first, kvs[i].second))
+        size_++;
+    });
+    afterWrite();
+  }
+
+  // Erase every key, taking each bucket mutex once.
+  void multi_erase(std::vector<Key> const &keys) {
+    EpochReclamation::Guard guard;
+    withBuckets(hashesOf(keys), [&](Bucket &bucket, size_t i) {
+      if (bucket.erase(keys[i]))
+        size_--;
+    });
+    afterWrite();
+  }
+
+  // Holds bucket migration off while it lives, so every pair stays in one
+  // live bucket and all shards of a scan see the same tables. Writers carry
+  // on, a pending resize resumes once the last Scan is gone and resize()
+  // waits for it.
+  class Scan {
+  public:
+    explicit Scan(ThreadSafeHashMap &map) : map_{map} {
+      map_.scans_.fetch_add(1);
+      // a migration batch that started before us finishes first
+      while (map_.migrators_.load() != 0)
+        std::this_thread::yield();
+    }
+    ~Scan() { map_.scans_.fetch_sub(1, std::memory_order_release); }
+    Scan(Scan const &) = delete;
+    Scan &operator=(Scan const &) = delete;
+
+  private:
+    ThreadSafeHashMap &map_;
+  };
+
+  Scan scan() { return Scan(*this); }
+
+  // Call f(key, value) for every pair, reading the buckets without their
+  // locks. Every pair present for the whole traversal is visited exactly
+  // once, pairs added or removed meanwhile may or may not be. The traversal
+  // holds an epoch guard, so memory retired meanwhile is freed afterwards.
+  template <typename F> void for_each(F f) { for_each(scan(), f, 0, 1); }
+
+  // One shard of a parallel for_each: call it from shard_count threads with
+  // shard = 0 .. shard_count - 1 while scan lives, together they visit
+  // every pair as above.
+  template <typename F>
+  void for_each(Scan const &, F f, size_t shard, size_t shard_count) {
+    EpochReclamation::Guard guard;
+    // with migration held off a pair is in exactly one unmigrated bucket
+    for (Table *table = guard.protect(0, table_); table != nullptr;
+         table = table->next_.load(std::memory_order_acquire)) {
+      size_t begin = table->bucket_cnt_ * shard / shard_count;
+      size_t end = table->bucket_cnt_ * (shard + 1) / shard_count;
+      for (size_t i = begin; i < end; i++) {
+        Bucket &bucket = table->buckets_[i];
+        if (!bucket.migrated_.load(std::memory_order_acquire))
+          bucket.forEach(f);
       }
     }
-    std::swap(buckets_, buckets);
-    delete [] buckets;
-    bucket_cnt_ = bucket_cnt;
+  }
+
+  std::vector<std::pair<Key, Value>> snapshot() {
+    std::vector<std::pair<Key, Value>> kvs;
+    kvs.reserve(size_);
+    for_each([&](Key const &key, Value const &value) { kvs.emplace_back(key, value); });
+    return kvs;
+  }
+
+  // Resize to bucket_cnt buckets and finish the migration before returning.
+  // A resize started by someone else in the meantime is finished first and
+  // then replaced by this one. Waits for every Scan to go away.
+  void resize(size_t bucket_cnt) {
+    EpochReclamation::Guard guard;
+    bucket_cnt = std::max<size_t>(bucket_cnt, 1);
+    while (true) {
+      Table *newest = finishMigration();
+      if (newest->bucket_cnt_ == bucket_cnt)
+        return;
+      if (startResize(newest, bucket_cnt))
+        break;
+    }
+    finishMigration();
   }
 
   void clear() {
-    std::unique_lock<std::shared_timed_mutex> exclusive_lock(mtx_);
-    for (int i = 0; i < bucket_cnt_; i++) {
-      buckets_[i].kvs_.clear();
-    }    
-    size_.store(0);
+    EpochReclamation::Guard guard;
+    for (Table *table = guard.protect(0, table_); table != nullptr;
+         table = table->next_.load(std::memory_order_acquire)) {
+      for (size_t i = 0; i < table->bucket_cnt_; i++) {
+        Bucket &bucket = table->buckets_[i];
+        std::unique_lock<std::mutex> write_lock(bucket.mtx_);
+        if (bucket.migrated_.load(std::memory_order_relaxed))
+          continue;
+        size_ -= bucket.clear();
+      }
+    }
   }
 
   size_t size() {
     return size_;
   }
 
+  // buckets of the newest table, the one a pending resize migrates into
+  size_t bucket_count() {
+    EpochReclamation::Guard guard;
+    Table *table = guard.protect(0, table_);
+    for (Table *next; (next = table->next_.load(std::memory_order_acquire)) != nullptr;)
+      table = next;
+    return table->bucket_cnt_;
+  }
+
+  // true while an incremental resize is in progress
+  bool migrating() {
+    EpochReclamation::Guard guard;
+    return guard.protect(0, table_)->next_.load(std::memory_order_acquire) !=
+           nullptr;
+  }
+
 private:
+  // number of buckets every put/erase moves to the new table
+  static constexpr size_t kMigrateBatch = 2;
+
+  struct Node {
+    Node(Key const &key, Value const &value, Node *next)
+        : key_{key}, value_{value}, next_{next} {}
+    Key const key_;
+    Value const value_;
+    std::atomic<Node *> next_;
+  };
+
   class Bucket {
     public:
-    // return true if a new pair is added
+    ~Bucket() {
+      Node *node = head_.load(std::memory_order_relaxed);
+      while (node != nullptr) {
+        Node *next = node->next_.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+      }
+    }
+    // return true if a new pair is added, caller holds mtx_
     bool put(Key const &key, Value const &value) {
-      std::unique_lock<std::shared_timed_mutex> write_lock(mtx_);
-      for (auto &kv : kvs_) {
-        if (kv.first == key) {
-          kv.second = value;
+      std::atomic<Node *> *link = &head_;
+      for (Node *node = link->load(std::memory_order_relaxed); node != nullptr;
+           node = link->load(std::memory_order_relaxed)) {
+        if (node->key_ == key) {
+          Node *fresh = new Node(key, value,
+                                 node->next_.load(std::memory_order_relaxed));
+          link->store(fresh, std::memory_order_release);
+          EpochReclamation::retire(node);
           return false;
         }
+        link = &node->next_;
       }
-      kvs_.emplace_back(key, value);
+      push(key, value);
       return true;
     }
-    // return true if a pair is erased.
+    // return true if a pair is erased, caller holds mtx_
     bool erase(Key const &key) {
-      std::unique_lock<std::shared_timed_mutex> write_lock(mtx_);
-      for (auto it = kvs_.begin(); it != kvs_.end(); it++) {
-        if (it->first == key) {
-          kvs_.erase(it);
+      std::atomic<Node *> *link = &head_;
+      for (Node *node = link->load(std::memory_order_relaxed); node != nullptr;
+           node = link->load(std::memory_order_relaxed)) {
+        if (node->key_ == key) {
+          link->store(node->next_.load(std::memory_order_relaxed),
+                      std::memory_order_release);
+          EpochReclamation::retire(node);
           return true;
         }
+        link = &node->next_;
       }
       return false;
     }
-    Value get(Key const &key) {
-      std::shared_lock<std::shared_timed_mutex> read_lock(mtx_);
-      for (auto &kv : kvs_) {
-        if (kv.first == key)
-          return kv.second;
+    // lock-free, caller is inside an epoch guard
+    std::optional<Value> get(Key const &key) const {
+      for (Node *node = head_.load(std::memory_order_acquire); node != nullptr;
+           node = node->next_.load(std::memory_order_acquire)) {
+        if (node->key_ == key)
+          return node->value_;
       }
-      return Value();
+      return std::nullopt;
     }
-    std::shared_timed_mutex mtx_;
-    std::list<std::pair<Key, Value>> kvs_;
+    // lock-free, caller is inside an epoch guard
+    template <typename F> void forEach(F &f) const {
+      for (Node *node = head_.load(std::memory_order_acquire); node != nullptr;
+           node = node->next_.load(std::memory_order_acquire))
+        f(node->key_, node->value_);
+    }
+    void push(Key const &key, Value const &value) {
+      head_.store(new Node(key, value, head_.load(std::memory_order_relaxed)),
+                  std::memory_order_release);
+    }
+    // unlink every pair and return how many there were, caller holds mtx_
+    size_t clear() {
+      size_t n = 0;
+      Node *node = head_.exchange(nullptr, std::memory_order_acq_rel);
+      while (node != nullptr) {
+        Node *next = node->next_.load(std::memory_order_relaxed);
+        EpochReclamation::retire(node);
+        node = next;
+        n++;
+      }
+      return n;
+    }
+    // serialises writers only
+    std::mutex mtx_;
+    // set once the pairs were copied to the next table
+    std::atomic<bool> migrated_{false};
+    std::atomic<Node *> head_{nullptr};
+  };
+
+  struct Table {
+    explicit Table(size_t bucket_cnt)
+        : bucket_cnt_{std::max<size_t>(bucket_cnt, 1)},
+          buckets_{new Bucket[bucket_cnt_]} {}
+    Bucket &bucketOf(size_t hash) { return buckets_[hash % bucket_cnt_]; }
+    size_t bucket_cnt_;
+    std::unique_ptr<Bucket[]> buckets_;
+    // the table this one migrates into, null when not resizing
+    std::atomic<Table *> next_{nullptr};
+    std::atomic<size_t> migrate_cursor_{0};
+    std::atomic<size_t> migrated_cnt_{0};
   };
-  size_t bucket_cnt_;
+
+  std::vector<size_t> hashesOf(std::vector<Key> const &keys) {
+    std::vector<size_t> hashes(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+      hashes[i] = getBucketId(keys[i]);
+    return hashes;
+  }
+
+  // indices of hashes ordered by their bucket in table
+  static std::vector<size_t> groupByBucket(std::vector<size_t> const &hashes,
+                                           Table *table) {
+    std::vector<size_t> order(hashes.size());
+    for (size_t i = 0; i < order.size(); i++)
+      order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return hashes[a] % table->bucket_cnt_ < hashes[b] % table->bucket_cnt_;
+    });
+    return order;
+  }
+
+  // Run op on the live bucket of hash with its mutex held. Must be called
+  // inside an epoch guard.
+  template <typename Op> void withBucket(size_t hash, Op op) {
+    for (Table *table = table_.load(std::memory_order_acquire);;
+         table = table->next_.load(std::memory_order_acquire)) {
+      Bucket &bucket = table->bucketOf(hash);
+      std::unique_lock<std::mutex> write_lock(bucket.mtx_);
+      if (bucket.migrated_.load(std::memory_order_relaxed))
+        continue;
+      op(bucket);
+      return;
+    }
+  }
+
+  // Run op(bucket, i) for every hash, locking each bucket of the oldest table
+  // once. Pairs of an already migrated bucket may spread over several buckets
+  // of the next table, those go one by one. Must be called inside an epoch
+  // guard.
+  template <typename Op>
+  void withBuckets(std::vector<size_t> const &hashes, Op op) {
+    Table *head = table_.load(std::memory_order_acquire);
+    std::vector<size_t> order = groupByBucket(hashes, head);
+    for (size_t begin = 0, end = 0; begin < order.size(); begin = end) {
+      Bucket &bucket = head->bucketOf(hashes[order[begin]]);
+      while (end < order.size() && &head->bucketOf(hashes[order[end]]) == &bucket)
+        end++;
+      std::unique_lock<std::mutex> write_lock(bucket.mtx_);
+      if (!bucket.migrated_.load(std::memory_order_relaxed)) {
+        for (size_t k = begin; k < end; k++)
+          op(bucket, order[k]);
+        continue;
+      }
+      write_lock.unlock();
+      for (size_t k = begin; k < end; k++) {
+        size_t i = order[k];
+        withBucket(hashes[i], [&](Bucket &live) { op(live, i); });
+      }
+    }
+  }
+
+  // help a pending migration and start a new one if the load factor is off
+  void afterWrite() {
+    Table *table = helpMigrate();
+    if (table == nullptr || size_ <= 50)
+      return;
+    if (size_ > 10 * table->bucket_cnt_ ||
+        (size_ < 5 * table->bucket_cnt_ && size_ / 3 < table->bucket_cnt_))
+      startResize(table, size_ / 3);
+  }
+
+  // Link a table of bucket_cnt buckets behind newest, returns false if
+  // another resize got there first.
+  bool startResize(Table *newest, size_t bucket_cnt) {
+    Table *expected = nullptr;
+    Table *table = new Table(bucket_cnt);
+    if (newest->next_.compare_exchange_strong(expected, table,
+                                              std::memory_order_acq_rel))
+      return true;
+    delete table;
+    return false;
+  }
+
+  // Move a few buckets of the oldest table unless a Scan holds migration
+  // off. Returns the live table once no migration is in progress, null
+  // otherwise. Must be called inside an epoch guard.
+  Table *helpMigrate() {
+    Table *table = table_.load(std::memory_order_acquire);
+    Table *next = table->next_.load(std::memory_order_acquire);
+    if (next == nullptr)
+      return table;
+    Table *live = nullptr;
+    // announced before checking for scans, a Scan waits for us to leave
+    migrators_.fetch_add(1);
+    for (size_t i = 0; i < kMigrateBatch && scans_.load() == 0; i++) {
+      size_t idx = table->migrate_cursor_.fetch_add(1, std::memory_order_relaxed);
+      if (idx >= table->bucket_cnt_)
+        break;
+      migrateBucket(table->buckets_[idx], next);
+      if (table->migrated_cnt_.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+          table->bucket_cnt_) {
+        table_.store(next, std::memory_order_release);
+        EpochReclamation::retire(table);
+        live = next;
+        break;
+      }
+    }
+    migrators_.fetch_sub(1, std::memory_order_release);
+    return live;
+  }
+
+  // help until no migration is in progress, returns the only live table
+  Table *finishMigration() {
+    while (true) {
+      Table *table = table_.load(std::memory_order_acquire);
+      if (table->next_.load(std::memory_order_acquire) == nullptr)
+        return table;
+      helpMigrate();
+      std::this_thread::yield();
+    }
+  }
+
+  // Copy the pairs instead of relinking the nodes, a reader may still be
+  // walking the old chain. The old nodes go away with their table.
+  static void migrateBucket(Bucket &bucket, Table *next) {
+    std::unique_lock<std::mutex> write_lock(bucket.mtx_);
+    for (Node *node = bucket.head_.load(std::memory_order_relaxed);
+         node != nullptr; node = node->next_.load(std::memory_order_relaxed)) {
+      Bucket &target = next->bucketOf(std::hash<Key>{}(node->key_));
+      std::unique_lock<std::mutex> target_lock(target.mtx_);
+      target.push(node->key_, node->value_);
+    }
+    bucket.migrated_.store(true, std::memory_order_release);
+  }
+
   std::atomic<size_t> size_{0};
-  Bucket* buckets_;
-  std::shared_timed_mutex mtx_;
+  std::atomic<Table *> table_;
+  // live Scans and helpMigrate() calls under way
+  std::atomic<size_t> scans_{0};
+  std::atomic<size_t> migrators_{0};
+};
+
+namespace detail {
+
+// MurmurHash3 finalizer. std::hash is the identity for integers, this spreads
+// every input bit over the whole word before it is cut into indices.
+inline uint64_t mixHash(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace detail
+
+// Open-addressing hash map split into a fixed number of lock stripes. Each
+// stripe is a flat table in the style of SwissTable: slots are stored
+// contiguously in groups of 16 with one control byte each, holding a 7-bit
+// fingerprint of the hash, so a probe compares a whole group with one SSE2
+// instruction and only touches slots whose fingerprint matches. Resizing a
+// stripe never blocks the other stripes.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ConcurrentHashMap {
+public:
+  static constexpr unsigned kStripeBits = 6;
+  static constexpr size_t kStripes = size_t(1) << kStripeBits;
+
+  explicit ConcurrentHashMap(size_t capacity = 0) {
+    size_t groups = 1;
+    while (groups * kGroupSize * kStripes * 7 / 8 < capacity)
+      groups <<= 1;
+    for (auto &stripe : stripes_)
+      stripe.table_.init(groups);
+  }
+
+  ConcurrentHashMap(ConcurrentHashMap const &) = delete;
+  ConcurrentHashMap &operator=(ConcurrentHashMap const &) = delete;
+
+  // return true if a new pair is added
+  bool put(Key const &key, Value const &value) {
+    size_t hash = hashOf(key);
+    Stripe &stripe = stripeOf(hash);
+    std::unique_lock<std::shared_timed_mutex> write_lock(stripe.mtx_);
+    bool added = stripe.table_.put(key, value, hash);
+    if (added)
+      stripe.size_.store(stripe.table_.size_, std::memory_order_relaxed);
+    return added;
+  }
+
+  // return true if a pair is erased
+  bool erase(Key const &key) {
+    size_t hash = hashOf(key);
+    Stripe &stripe = stripeOf(hash);
+    std::unique_lock<std::shared_timed_mutex> write_lock(stripe.mtx_);
+    bool erased = stripe.table_.erase(key, hash);
+    if (erased)
+      stripe.size_.store(stripe.table_.size_, std::memory_order_relaxed);
+    return erased;
+  }
+
+  std::optional<Value> get(Key const &key) {
+    size_t hash = hashOf(key);
+    Stripe &stripe = stripeOf(hash);
+    std::shared_lock<std::shared_timed_mutex> read_lock(stripe.mtx_);
+    std::pair<Key, Value> *slot = stripe.table_.find(key, hash);
+    if (slot == nullptr)
+      return std::nullopt;
+    return slot->second;
+  }
+
+  bool contains(Key const &key) { return get(key).has_value(); }
+
+  void clear() {
+    for (auto &stripe : stripes_) {
+      std::unique_lock<std::shared_timed_mutex> write_lock(stripe.mtx_);
+      stripe.table_.clear();
+      stripe.size_.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  size_t size() const {
+    size_t size = 0;
+    for (auto &stripe : stripes_)
+      size += stripe.size_.load(std::memory_order_relaxed);
+    return size;
+  }
+
+private:
+  static constexpr size_t kGroupSize = 16;
+  static constexpr int8_t kEmpty = -128;
+  static constexpr int8_t kDeleted = -2;
+
+  struct alignas(kGroupSize) Group {
+    // bit i is set if control byte i equals h2
+    uint32_t match(int8_t h2) const {
+#if defined(__SSE2__)
+      __m128i ctrl = _mm_load_si128(reinterpret_cast<__m128i const *>(ctrl_));
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+#else
+      uint32_t mask = 0;
+      for (size_t i = 0; i < kGroupSize; i++)
+        mask |= uint32_t(ctrl_[i] == h2) << i;
+      return mask;
+#endif
+    }
+    int8_t ctrl_[kGroupSize];
+  };
+
+  class Table {
+  public:
+    using Slot = std::pair<Key, Value>;
+
+    ~Table() { clear(); }
+
+    void init(size_t group_cnt) {
+      group_cnt_ = group_cnt;
+      groups_.reset(new Group[group_cnt]);
+      slots_.reset(new Storage[group_cnt * kGroupSize]);
+      for (size_t g = 0; g < group_cnt; g++)
+        std::fill(groups_[g].ctrl_, groups_[g].ctrl_ + kGroupSize, kEmpty);
+      size_ = 0;
+      deleted_ = 0;
+    }
+
+    Slot *find(Key const &key, size_t hash) const {
+      int8_t h2 = fingerprint(hash);
+      size_t mask = group_cnt_ - 1;
+      size_t g = groupOf(hash) & mask;
+      for (size_t probe = 0; probe < group_cnt_; probe++) {
+        Group const &group = groups_[g];
+        for (uint32_t bits = group.match(h2); bits != 0; bits &= bits - 1) {
+          Slot *slot = slotAt(g * kGroupSize + __builtin_ctz(bits));
+          if (slot->first == key)
+            return slot;
+        }
+        if (group.match(kEmpty) != 0)
+          return nullptr;
+        g = (g + probe + 1) & mask;
+      }
+      return nullptr;
+    }
+
+    bool put(Key const &key, Value const &value, size_t hash) {
+      if (Slot *slot = find(key, hash)) {
+        slot->second = value;
+        return false;
+      }
+      if ((size_ + deleted_ + 1) * 8 > group_cnt_ * kGroupSize * 7)
+        rehash(size_ * 2 >= group_cnt_ * kGroupSize ? group_cnt_ * 2
+                                                    : group_cnt_);
+      size_t index = findFree(hash);
+      if (groups_[index / kGroupSize].ctrl_[index % kGroupSize] == kDeleted)
+        deleted_--;
+      groups_[index / kGroupSize].ctrl_[index % kGroupSize] = fingerprint(hash);
+      new (&slots_[index]) Slot(key, value);
+      size_++;
+      return true;
+    }
+
+    bool erase(Key const &key, size_t hash) {
+      Slot *slot = find(key, hash);
+      if (slot == nullptr)
+        return false;
+      size_t index = reinterpret_cast<Storage *>(slot) - slots_.get();
+      Group &group = groups_[index / kGroupSize];
+      slot->~Slot();
+      // probes stop at a group with an empty byte, so the slot can become
+      // empty again instead of a tombstone if its group already has one
+      if (group.match(kEmpty) != 0) {
+        group.ctrl_[index % kGroupSize] = kEmpty;
+      } else {
+        group.ctrl_[index % kGroupSize] = kDeleted;
+        deleted_++;
+      }
+      size_--;
+      return true;
+    }
+
+    void clear() {
+      for (size_t i = 0; i < group_cnt_ * kGroupSize; i++) {
+        int8_t &ctrl = groups_[i / kGroupSize].ctrl_[i % kGroupSize];
+        if (ctrl >= 0)
+          slotAt(i)->~Slot();
+        ctrl = kEmpty;
+      }
+      size_ = 0;
+      deleted_ = 0;
+    }
+
+    size_t size_{0};
+
+  private:
+    using Storage = typename std::aligned_storage<sizeof(Slot), alignof(Slot)>::type;
+
+    static int8_t fingerprint(size_t hash) { return hash & 0x7f; }
+    static size_t groupOf(size_t hash) { return hash >> 7; }
+
+    Slot *slotAt(size_t index) const {
+      return reinterpret_cast<Slot *>(&slots_[index]);
+    }
+
+    size_t findFree(size_t hash) const {
+      size_t mask = group_cnt_ - 1;
+      size_t g = groupOf(hash) & mask;
+      for (size_t probe = 0;; probe++) {
+        uint32_t bits = groups_[g].match(kEmpty) | groups_[g].match(kDeleted);
+        if (bits != 0)
+          return g * kGroupSize + __builtin_ctz(bits);
+        g = (g + probe + 1) & mask;
+      }
+    }
+
+    void rehash(size_t group_cnt) {
+      std::unique_ptr<Group[]> groups = std::move(groups_);
+      std::unique_ptr<Storage[]> slots = std::move(slots_);
+      size_t old_cnt = group_cnt_;
+      init(group_cnt);
+      for (size_t i = 0; i < old_cnt * kGroupSize; i++) {
+        if (groups[i / kGroupSize].ctrl_[i % kGroupSize] < 0)
+          continue;
+        Slot *slot = reinterpret_cast<Slot *>(&slots[i]);
+        size_t hash = hashOf(slot->first);
+        size_t index = findFree(hash);
+        groups_[index / kGroupSize].ctrl_[index % kGroupSize] = fingerprint(hash);
+        new (&slots_[index]) Slot(std::move(*slot));
+        slot->~Slot();
+        size_++;
+      }
+    }
+
+    size_t group_cnt_{0};
+    size_t deleted_{0};
+    std::unique_ptr<Group[]> groups_;
+    std::unique_ptr<Storage[]> slots_;
+  };
+
+  struct alignas(kCacheLineSize) Stripe {
+    std::shared_timed_mutex mtx_;
+    std::atomic<size_t> size_{0};
+    Table table_;
+  };
+
+  // both the stripe (top bits) and the fingerprint (low bits) must see every
+  // input bit
+  static size_t hashOf(Key const &key) { return detail::mixHash(Hash{}(key)); }
+
+  Stripe &stripeOf(size_t hash) { return stripes_[hash >> (64 - kStripeBits)]; }
+
+  Stripe stripes_[kStripes];
 };
 
 } // namespace Container
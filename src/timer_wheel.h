@@ -0,0 +1,325 @@
+#ifndef TIMER_WHEEL
+#define TIMER_WHEEL
+
+#include "inplace_function.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Thread {
+
+// Hierarchical hashed timer wheel driven by its own thread. Level 0 has one
+// slot per tick, each higher level one slot per full turn of the level
+// below. A timer goes into the level its distance fits in and moves down a
+// level each time the level below wraps around, so insert and cancel are
+// O(1) and a tick only touches the timers that are due. Callbacks run on
+// the timer thread and should only hand work off, e.g. to a pool.
+class TimerWheel {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = InplaceFunction<64>;
+
+  // Identifies a timer for cancel(), safe to use after the timer is gone.
+  class TimerId {
+  public:
+    TimerId() = default;
+    bool valid() const { return index_ != kNone; }
+
+  private:
+    friend class TimerWheel;
+    TimerId(uint32_t index, uint32_t generation)
+        : index_{index}, generation_{generation} {}
+    uint32_t index_{kNone};
+    uint32_t generation_{0};
+  };
+
+  explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1))
+      : tick_{tick}, start_{Clock::now()} {
+    for (auto &level : slots_)
+      std::fill(std::begin(level), std::end(level), kNone);
+    thread_ = std::thread(&TimerWheel::run, this);
+  }
+
+  ~TimerWheel() { stop(); }
+
+  TimerWheel(TimerWheel const &) = delete;
+  TimerWheel &operator=(TimerWheel const &) = delete;
+
+  // Run callback once deadline has passed, at most one tick late. Returns an
+  // invalid id after stop().
+  TimerId schedule(Clock::time_point deadline, Callback &&callback) {
+    return add(deadline, Clock::duration::zero(), std::move(callback));
+  }
+
+  TimerId schedule(Clock::duration delay, Callback &&callback) {
+    return add(Clock::now() + delay, Clock::duration::zero(),
+               std::move(callback));
+  }
+
+  // Run callback every period, starting one period from now, until the
+  // timer is cancelled. A run that falls behind skips the missed periods.
+  TimerId scheduleEvery(Clock::duration period, Callback &&callback) {
+    period = std::max(period, tick_);
+    return add(Clock::now() + period, period, std::move(callback));
+  }
+
+  // Returns true if the timer was pending. A periodic timer cancelled while
+  // its callback runs is not rescheduled.
+  bool cancel(TimerId id) {
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (!id.valid() || id.index_ >= nodes_.size())
+      return false;
+    Node &node = nodes_[id.index_];
+    if (node.generation_ != id.generation_ || node.state_ == kFree)
+      return false;
+    if (node.state_ == kRunning) {
+      node.state_ = kCancelled;
+      return true;
+    }
+    if (node.state_ == kCancelled)
+      return false;
+    unlink(id.index_);
+    release(id.index_);
+    return true;
+  }
+
+  // Stop the timer thread, pending timers are dropped without running.
+  // Called from a callback, the thread leaves its loop once the callback
+  // returns and a later stop() or the destructor joins it.
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lck(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id())
+      thread_.join();
+    std::lock_guard<std::mutex> lck(mtx_);
+    nodes_.clear();
+    free_.clear();
+    size_ = 0;
+  }
+
+  // number of pending timers, periodic ones included
+  size_t size() const {
+    std::lock_guard<std::mutex> lck(mtx_);
+    return size_;
+  }
+
+private:
+  static constexpr uint32_t kNone = UINT32_MAX;
+  static constexpr unsigned kSlotBits = 6;
+  static constexpr uint64_t kSlots = 1 << kSlotBits;
+  static constexpr uint64_t kSlotMask = kSlots - 1;
+  static constexpr unsigned kLevels = 4;
+  // timers further out wait in the last slot and are placed again later
+  static constexpr uint64_t kMaxDistance = (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+
+  enum State : uint8_t { kFree, kLinked, kRunning, kCancelled };
+
+  struct Node {
+    uint64_t tick_{0};
+    uint64_t period_{0};
+    Callback callback_;
+    uint32_t prev_{kNone};
+    uint32_t next_{kNone};
+    uint32_t generation_{0};
+    uint16_t slot_{0};
+    State state_{kFree};
+  };
+
+  TimerId add(Clock::time_point deadline, Clock::duration period,
+              Callback &&callback) {
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (stop_)
+      return {};
+    // the thread does not tick while the wheel is empty, catch up first
+    if (size_ == 0)
+      current_ = std::max(current_, elapsedTicks());
+    uint32_t index;
+    if (free_.empty()) {
+      index = static_cast<uint32_t>(nodes_.size());
+      nodes_.emplace_back();
+    } else {
+      index = free_.back();
+      free_.pop_back();
+    }
+    Node &node = nodes_[index];
+    node.tick_ = ticksUntil(deadline);
+    node.period_ = static_cast<uint64_t>(period / tick_);
+    node.callback_ = std::move(callback);
+    link(index);
+    size_++;
+    if (node.tick_ < wake_tick_)
+      cv_.notify_one();
+    return TimerId(index, node.generation_);
+  }
+
+  void link(uint32_t index) {
+    Node &node = nodes_[index];
+    node.tick_ = std::max(node.tick_, current_);
+    uint64_t distance = std::min(node.tick_ - current_, kMaxDistance);
+    uint64_t tick = current_ + distance;
+    unsigned level = 0;
+    while (distance >= kSlots) {
+      distance >>= kSlotBits;
+      level++;
+    }
+    uint32_t &head = slots_[level][(tick >> (kSlotBits * level)) & kSlotMask];
+    node.slot_ = static_cast<uint16_t>(level * kSlots +
+                                       ((tick >> (kSlotBits * level)) & kSlotMask));
+    node.state_ = kLinked;
+    node.prev_ = kNone;
+    node.next_ = head;
+    if (head != kNone)
+      nodes_[head].prev_ = index;
+    head = index;
+  }
+
+  void unlink(uint32_t index) {
+    Node &node = nodes_[index];
+    if (node.prev_ != kNone)
+      nodes_[node.prev_].next_ = node.next_;
+    else
+      slots_[node.slot_ / kSlots][node.slot_ % kSlots] = node.next_;
+    if (node.next_ != kNone)
+      nodes_[node.next_].prev_ = node.prev_;
+  }
+
+  void release(uint32_t index) {
+    Node &node = nodes_[index];
+    node.callback_ = Callback();
+    node.state_ = kFree;
+    node.generation_++;
+    free_.push_back(index);
+    size_--;
+  }
+
+  // detach the list of one slot
+  uint32_t take(unsigned level, uint64_t slot) {
+    uint32_t head = slots_[level][slot];
+    slots_[level][slot] = kNone;
+    return head;
+  }
+
+  // Called when tick current_ starts: move the timers of every level whose
+  // lower level just wrapped around one level down, then collect the timers
+  // due now.
+  void advance(std::vector<uint32_t> &due) {
+    for (unsigned level = 1; level < kLevels; level++) {
+      if (((current_ >> (kSlotBits * (level - 1))) & kSlotMask) != 0)
+        break;
+      uint32_t index = take(level, (current_ >> (kSlotBits * level)) & kSlotMask);
+      while (index != kNone) {
+        uint32_t next = nodes_[index].next_;
+        link(index);
+        index = next;
+      }
+    }
+    uint32_t index = take(0, current_ & kSlotMask);
+    while (index != kNone) {
+      uint32_t next = nodes_[index].next_;
+      if (nodes_[index].tick_ <= current_)
+        due.push_back(index);
+      else
+        link(index);
+      index = next;
+    }
+  }
+
+  // first tick at or after time
+  uint64_t ticksUntil(Clock::time_point time) const {
+    if (time <= start_)
+      return 0;
+    return (time - start_ + tick_ - Clock::duration(1)) / tick_;
+  }
+
+  uint64_t elapsedTicks() const { return (Clock::now() - start_) / tick_; }
+
+  // the next tick with timers in level 0 or where a higher level moves down
+  uint64_t nextTick() const {
+    uint64_t boundary = (current_ | kSlotMask) + 1;
+    for (uint64_t tick = current_; tick < boundary; tick++) {
+      if (slots_[0][tick & kSlotMask] != kNone)
+        return tick;
+    }
+    return boundary;
+  }
+
+  void run() {
+    std::vector<uint32_t> due;
+    std::vector<Callback> callbacks;
+    std::unique_lock<std::mutex> lck(mtx_);
+    while (!stop_) {
+      if (size_ == 0) {
+        wake_tick_ = UINT64_MAX;
+        cv_.wait(lck, [this] { return stop_ || size_ > 0; });
+        continue;
+      }
+      uint64_t now = elapsedTicks();
+      while (current_ <= now) {
+        advance(due);
+        current_++;
+      }
+      if (due.empty()) {
+        wake_tick_ = nextTick();
+        cv_.wait_until(lck, start_ + tick_ * wake_tick_);
+        continue;
+      }
+      // one-shot nodes are released now, periodic ones after they ran
+      for (uint32_t index : due) {
+        Node &node = nodes_[index];
+        callbacks.push_back(std::move(node.callback_));
+        if (node.period_ == 0)
+          release(index);
+        else
+          node.state_ = kRunning;
+      }
+      lck.unlock();
+      for (auto &callback : callbacks)
+        callback();
+      lck.lock();
+      // a callback stopped the wheel and dropped the nodes
+      if (stop_)
+        break;
+      for (size_t i = 0; i < due.size(); i++) {
+        Node &node = nodes_[due[i]];
+        if (node.state_ == kCancelled) {
+          release(due[i]);
+        } else if (node.state_ == kRunning) {
+          node.callback_ = std::move(callbacks[i]);
+          node.tick_ += node.period_;
+          if (node.tick_ < current_)
+            node.tick_ += (current_ - node.tick_ + node.period_ - 1) /
+                          node.period_ * node.period_;
+          link(due[i]);
+        }
+      }
+      due.clear();
+      callbacks.clear();
+    }
+  }
+
+  Clock::duration const tick_;
+  Clock::time_point const start_;
+  mutable std::mutex mtx_;
+  std::condition_variable cv_;
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> free_;
+  uint32_t slots_[kLevels][kSlots];
+  // next tick to process
+  uint64_t current_{0};
+  // tick the thread sleeps until, an earlier timer has to wake it
+  uint64_t wake_tick_{0};
+  size_t size_{0};
+  bool stop_{false};
+  std::thread thread_;
+};
+
+} // namespace Thread
+
+#endif
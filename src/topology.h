@@ -0,0 +1,188 @@
+#ifndef TOPOLOGY
+#define TOPOLOGY
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Thread {
+
+// CPUs the process may run on, grouped by NUMA node. On Linux they come from
+// sched_getaffinity and /sys/devices/system/node; elsewhere, or without
+// sysfs, every CPU reported by hardware_concurrency() is on a single node.
+// Nodes without an allowed CPU are dropped and the rest are numbered densely
+// in sysfs order.
+class Topology {
+public:
+  // node_cpus[n] lists the CPUs of node n
+  explicit Topology(std::vector<std::vector<int>> node_cpus) {
+    for (auto &cpus : node_cpus) {
+      if (cpus.empty())
+        continue;
+      std::sort(cpus.begin(), cpus.end());
+      size_t node = node_cpus_.size();
+      for (int cpu : cpus) {
+        if (static_cast<size_t>(cpu) >= node_of_.size())
+          node_of_.resize(cpu + 1, 0);
+        node_of_[cpu] = node;
+        cpus_.push_back(cpu);
+      }
+      node_cpus_.push_back(std::move(cpus));
+    }
+    if (node_cpus_.empty()) {
+      node_cpus_.push_back({0});
+      cpus_.push_back(0);
+      node_of_.push_back(0);
+    }
+  }
+
+  static Topology const &system() {
+    static Topology const topology(discover());
+    return topology;
+  }
+
+  size_t nodes() const { return node_cpus_.size(); }
+
+  std::vector<int> const &cpus(size_t node) const { return node_cpus_[node]; }
+
+  // every allowed CPU, node by node
+  std::vector<int> const &cpus() const { return cpus_; }
+
+  // node of cpu, 0 if it is unknown
+  size_t nodeOf(int cpu) const {
+    if (cpu < 0 || static_cast<size_t>(cpu) >= node_of_.size())
+      return 0;
+    return node_of_[cpu];
+  }
+
+  // node the calling thread runs on right now
+  size_t currentNode() const {
+#ifdef __linux__
+    return nodeOf(sched_getcpu());
+#else
+    return 0;
+#endif
+  }
+
+  // CPUs taking turns between the nodes, so the first k workers placed in
+  // this order spread over as many nodes as possible
+  std::vector<int> interleaved() const {
+    std::vector<int> order;
+    for (size_t i = 0; order.size() < cpus_.size(); i++) {
+      for (auto &cpus : node_cpus_) {
+        if (i < cpus.size())
+          order.push_back(cpus[i]);
+      }
+    }
+    return order;
+  }
+
+  // parse a sysfs cpu list such as "0-3,8,10-11"
+  static std::vector<int> parseCpuList(std::string const &list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+      if (range.empty() || range == "\n")
+        continue;
+      size_t dash = range.find('-');
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; cpu++)
+        cpus.push_back(cpu);
+    }
+    return cpus;
+  }
+
+  // Returns false if the thread could not be pinned, e.g. off Linux.
+  static bool pinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+  }
+
+private:
+  static std::vector<std::vector<int>> discover() {
+    std::vector<int> allowed;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set))
+          allowed.push_back(cpu);
+      }
+    }
+#endif
+    if (allowed.empty()) {
+      for (unsigned cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++)
+        allowed.push_back(cpu);
+    }
+    std::vector<std::vector<int>> node_cpus;
+#ifdef __linux__
+    std::vector<int> node_ids;
+    if (DIR *dir = opendir("/sys/devices/system/node")) {
+      while (dirent *entry = readdir(dir)) {
+        int id;
+        char tail;
+        if (std::sscanf(entry->d_name, "node%d%c", &id, &tail) == 1)
+          node_ids.push_back(id);
+      }
+      closedir(dir);
+    }
+    std::sort(node_ids.begin(), node_ids.end());
+    for (int id : node_ids) {
+      std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+      std::string list;
+      std::getline(file, list);
+      std::vector<int> cpus;
+      for (int cpu : parseCpuList(list)) {
+        if (std::binary_search(allowed.begin(), allowed.end(), cpu))
+          cpus.push_back(cpu);
+      }
+      node_cpus.push_back(std::move(cpus));
+    }
+#endif
+    // allowed CPUs sysfs did not mention go to the first node
+    std::vector<int> listed;
+    for (auto &cpus : node_cpus)
+      listed.insert(listed.end(), cpus.begin(), cpus.end());
+    std::sort(listed.begin(), listed.end());
+    std::vector<int> rest;
+    std::set_difference(allowed.begin(), allowed.end(), listed.begin(),
+                        listed.end(), std::back_inserter(rest));
+    if (!rest.empty()) {
+      auto first = std::find_if(node_cpus.begin(), node_cpus.end(),
+                                [](auto &cpus) { return !cpus.empty(); });
+      if (first == node_cpus.end())
+        node_cpus.push_back(rest);
+      else
+        first->insert(first->end(), rest.begin(), rest.end());
+    }
+    return node_cpus;
+  }
+
+  std::vector<std::vector<int>> node_cpus_;
+  std::vector<int> cpus_;
+  std::vector<size_t> node_of_;
+};
+
+} // namespace Thread
+
+#endif
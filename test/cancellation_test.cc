@@ -0,0 +1,27 @@
+#include "src/cancellation.h"
+
+#include "gtest/gtest.h"
+
+namespace Thread
+{
+    TEST(CancellationTest, TokensShareTheFlag)
+    {
+        CancellationSource source;
+        CancellationToken token = source.token();
+        CancellationToken copy = token;
+        EXPECT_TRUE(token.canBeCancelled());
+        EXPECT_FALSE(token.isCancelled());
+        EXPECT_TRUE(source.cancel());
+        EXPECT_FALSE(source.cancel());
+        EXPECT_TRUE(source.isCancelled());
+        EXPECT_TRUE(token.isCancelled());
+        EXPECT_TRUE(copy.isCancelled());
+    }
+
+    TEST(CancellationTest, DefaultTokenIsNeverCancelled)
+    {
+        CancellationToken token;
+        EXPECT_FALSE(token.canBeCancelled());
+        EXPECT_FALSE(token.isCancelled());
+    }
+};
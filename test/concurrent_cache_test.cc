@@ -0,0 +1,96 @@
+#include "src/concurrent_cache.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace Container
+{
+    TEST(ConcurrentCacheTest, PutGetErase)
+    {
+        ConcurrentCache<int, std::string> cache(100, 4);
+        cache.put(1, "one");
+        cache.put(2, "two");
+        EXPECT_EQ(cache.get(1), "one");
+        EXPECT_EQ(cache.get(3), std::nullopt);
+        cache.put(1, "uno");
+        EXPECT_EQ(cache.get(1), "uno");
+        EXPECT_EQ(cache.size(), 2);
+        EXPECT_TRUE(cache.erase(2));
+        EXPECT_FALSE(cache.erase(2));
+        EXPECT_EQ(cache.get(2), std::nullopt);
+        auto stats = cache.stats();
+        EXPECT_EQ(stats.hits_, 2);
+        EXPECT_EQ(stats.misses_, 2);
+    }
+
+    TEST(ConcurrentCacheTest, EvictUnreferencedFirst)
+    {
+        ConcurrentCache<int, int> cache(4, 1);
+        for (int i = 0; i < 4; i++)
+            cache.put(i, i);
+        EXPECT_EQ(cache.get(0), 0);
+        EXPECT_EQ(cache.get(2), 2);
+        cache.put(4, 4);
+        cache.put(5, 5);
+        EXPECT_EQ(cache.size(), 4);
+        EXPECT_EQ(cache.get(0), 0);
+        EXPECT_EQ(cache.get(2), 2);
+        EXPECT_EQ(cache.get(1), std::nullopt);
+        EXPECT_EQ(cache.get(3), std::nullopt);
+        EXPECT_EQ(cache.stats(0).evictions_, 2);
+    }
+
+    TEST(ConcurrentCacheTest, WeightBudget)
+    {
+        ConcurrentCache<int, std::string> cache(
+            10, 1, [](int, std::string const &value) { return value.size(); });
+        cache.put(1, "aaaa");
+        cache.put(2, "bbbb");
+        EXPECT_EQ(cache.weight(), 8);
+        cache.put(3, "cccc");
+        EXPECT_LE(cache.weight(), 10);
+        EXPECT_EQ(cache.get(3), "cccc");
+        EXPECT_EQ(cache.size(), 2);
+    }
+
+    TEST(ConcurrentCacheTest, Expiration)
+    {
+        ConcurrentCache<int, int> cache(100, 2);
+        cache.put(1, 1, std::chrono::milliseconds(10));
+        cache.put(2, 2);
+        EXPECT_EQ(cache.get(1), 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_EQ(cache.get(1), std::nullopt);
+        EXPECT_EQ(cache.get(2), 2);
+        EXPECT_EQ(cache.size(), 1);
+        EXPECT_EQ(cache.stats().expirations_, 1);
+    }
+
+    TEST(ConcurrentCacheTest, ConcurrentAccess)
+    {
+        ConcurrentCache<int, int> cache(256, 8);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&cache, t]() {
+                for (int i = 0; i < 20000; i++)
+                {
+                    int key = (i * 7 + t) % 1024;
+                    if (auto value = cache.get(key))
+                        EXPECT_EQ(*value, key * 2);
+                    else
+                        cache.put(key, key * 2);
+                    if (i % 100 == 0)
+                        cache.erase(key);
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        EXPECT_LE(cache.size(), 256);
+        auto stats = cache.stats();
+        EXPECT_EQ(stats.hits_ + stats.misses_, 4 * 20000);
+    }
+} // namespace Container
@@ -0,0 +1,84 @@
+#include "src/coroutine.h"
+#include "src/thread_pool.h"
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace Thread::Coro
+{
+    using namespace std::chrono_literals;
+
+    Task<int> add(int a, int b)
+    {
+        co_return a + b;
+    }
+
+    Task<int> sum()
+    {
+        int x = co_await add(1, 2);
+        int y = co_await add(x, 3);
+        co_return y;
+    }
+
+    Task<void> fail()
+    {
+        throw std::runtime_error("fail");
+        co_return;
+    }
+
+    TEST(CoroutineTest, SyncWait)
+    {
+        EXPECT_EQ(syncWait(sum()), 6);
+        EXPECT_THROW(syncWait(fail()), std::runtime_error);
+    }
+
+    template <typename Pool>
+    Task<std::thread::id> handle(Scheduler<Pool> &scheduler, Pool &pool)
+    {
+        co_await scheduler.schedule();
+        co_await scheduler.sleepFor(5ms);
+        int value = co_await pool.submit([]() { return 42; });
+        EXPECT_EQ(value, 42);
+        co_return std::this_thread::get_id();
+    }
+
+    TEST(CoroutineTest, ResumeOnPool)
+    {
+        v3::ThreadPoolImpl v3_pool(2);
+        v4::ThreadPoolImpl v4_pool(2);
+        v3_pool.start();
+        v4_pool.start();
+        Scheduler v3_scheduler(v3_pool);
+        Scheduler v4_scheduler(v4_pool);
+        EXPECT_NE(syncWait(handle(v3_scheduler, v3_pool)), std::this_thread::get_id());
+        EXPECT_NE(syncWait(handle(v4_scheduler, v4_pool)), std::this_thread::get_id());
+        v3_pool.shutdown();
+        v4_pool.shutdown();
+    }
+
+    Task<void> sleeper(Scheduler<v4::ThreadPoolImpl> &scheduler, std::atomic<int> &cnt)
+    {
+        co_await scheduler.sleepFor(20ms);
+        cnt++;
+    }
+
+    TEST(CoroutineTest, ManySleepersShareFewThreads)
+    {
+        v4::ThreadPoolImpl pool(2);
+        pool.start();
+        Scheduler scheduler(pool);
+        std::atomic<int> cnt{0};
+        const int N = 1000;
+        std::vector<Future<void>> done;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < N; i++)
+            done.push_back(scheduler.spawn(sleeper(scheduler, cnt)));
+        when_all(std::move(done)).get();
+        EXPECT_EQ(cnt.load(), N);
+        // the sleeps overlap instead of running back to back
+        EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+        pool.shutdown();
+    }
+} // namespace Thread::Coro
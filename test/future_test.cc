@@ -0,0 +1,127 @@
+#include "src/future.h"
+#include "src/thread_pool.h"
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace Thread
+{
+    TEST(FutureTest, SetBeforeAndAfterGet)
+    {
+        Promise<int> ready;
+        Future<int> ready_future = ready.get_future();
+        ready.set_value(1);
+        EXPECT_TRUE(ready_future.ready());
+        EXPECT_EQ(ready_future.get(), 1);
+        EXPECT_FALSE(ready_future.valid());
+
+        Promise<std::string> pending;
+        Future<std::string> pending_future = pending.get_future();
+        std::thread setter([&pending]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            pending.set_value("done");
+        });
+        EXPECT_EQ(pending_future.get(), "done");
+        setter.join();
+    }
+
+    TEST(FutureTest, ExceptionAndBrokenPromise)
+    {
+        Promise<int> promise;
+        Future<int> future = promise.get_future();
+        promise.set_exception(std::make_exception_ptr(std::runtime_error("fail")));
+        EXPECT_THROW(future.get(), std::runtime_error);
+
+        Future<void> broken;
+        {
+            Promise<void> dropped;
+            broken = dropped.get_future();
+        }
+        EXPECT_THROW(broken.get(), std::future_error);
+    }
+
+    TEST(FutureTest, ThenChain)
+    {
+        Promise<int> promise;
+        Future<std::string> result = promise.get_future()
+                                         .then([](int x) { return x * 2; })
+                                         .then([](int x) { return std::to_string(x); });
+        promise.set_value(21);
+        EXPECT_EQ(result.get(), "42");
+
+        Promise<int> failing;
+        int calls = 0;
+        Future<int> skipped = failing.get_future().then([&calls](int x) {
+            calls++;
+            return x;
+        });
+        failing.set_exception(std::make_exception_ptr(std::logic_error("fail")));
+        EXPECT_THROW(skipped.get(), std::logic_error);
+        EXPECT_EQ(calls, 0);
+    }
+
+    TEST(FutureTest, ThenOnPool)
+    {
+        v3::ThreadPoolImpl v3_pool(2);
+        v4::ThreadPoolImpl v4_pool(2);
+        v3_pool.start();
+        v4_pool.start();
+        std::thread::id caller = std::this_thread::get_id();
+        Future<bool> v3_result = v3_pool.submit([]() { return 1; })
+                                     .then(v3_pool, [caller](int) {
+                                         return std::this_thread::get_id() != caller;
+                                     });
+        Future<bool> v4_result = v4_pool.submit([]() { return 1; })
+                                     .then(v4_pool, [caller](int) {
+                                         return std::this_thread::get_id() != caller;
+                                     });
+        EXPECT_TRUE(v3_result.get());
+        EXPECT_TRUE(v4_result.get());
+        v3_pool.shutdown();
+        v4_pool.shutdown();
+    }
+
+    TEST(FutureTest, WhenAll)
+    {
+        v4::ThreadPoolImpl pool(4);
+        pool.start();
+        std::vector<Future<int>> futures;
+        for (int i = 0; i < 100; i++)
+            futures.push_back(pool.submit([i]() { return i * i; }));
+        std::vector<int> values = when_all(std::move(futures)).get();
+        ASSERT_EQ(values.size(), 100);
+        for (int i = 0; i < 100; i++)
+            EXPECT_EQ(values[i], i * i);
+
+        std::atomic<int> cnt{0};
+        std::vector<Future<void>> done;
+        for (int i = 0; i < 100; i++)
+            done.push_back(pool.submit([&cnt]() { cnt++; }));
+        when_all(std::move(done)).get();
+        EXPECT_EQ(cnt.load(), 100);
+
+        std::vector<Future<int>> failing;
+        failing.push_back(pool.submit([]() { return 1; }));
+        failing.push_back(pool.submit([]() -> int { throw std::runtime_error("fail"); }));
+        EXPECT_THROW(when_all(std::move(failing)).get(), std::runtime_error);
+        pool.shutdown();
+    }
+
+    TEST(FutureTest, WhenAny)
+    {
+        Promise<int> slow, fast;
+        std::vector<Future<int>> futures;
+        futures.push_back(slow.get_future());
+        futures.push_back(fast.get_future());
+        Future<std::pair<size_t, int>> first = when_any(std::move(futures));
+        EXPECT_FALSE(first.ready());
+        fast.set_value(2);
+        auto result = first.get();
+        EXPECT_EQ(result.first, 1);
+        EXPECT_EQ(result.second, 2);
+        slow.set_value(1);
+    }
+} // namespace Thread
@@ -0,0 +1,70 @@
+#include "src/inplace_function.h"
+#include <array>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace Thread
+{
+    using Function = InplaceFunction<64>;
+
+    TEST(InplaceFunctionTest, SmallCallableIsInline)
+    {
+        int cnt = 0;
+        Function f([&cnt]() { cnt++; });
+        EXPECT_TRUE(f.isInline());
+        f();
+        f();
+        EXPECT_EQ(cnt, 2);
+        Function empty;
+        EXPECT_FALSE(empty);
+    }
+
+    TEST(InplaceFunctionTest, LargeCallableFallsBackToHeap)
+    {
+        std::array<long, 32> data{};
+        data[31] = 7;
+        long result = 0;
+        Function f([data, &result]() { result = data[31]; });
+        EXPECT_FALSE(f.isInline());
+        Function g(std::move(f));
+        EXPECT_FALSE(f);
+        g();
+        EXPECT_EQ(result, 7);
+    }
+
+    TEST(InplaceFunctionTest, MoveOnlyCapture)
+    {
+        auto ptr = std::make_unique<int>(5);
+        int result = 0;
+        Function f([ptr = std::move(ptr), &result]() { result = *ptr; });
+        Function g;
+        g = std::move(f);
+        g();
+        EXPECT_EQ(result, 5);
+
+        std::packaged_task<int()> task([]() { return 42; });
+        std::future<int> future = task.get_future();
+        Function h(std::move(task));
+        EXPECT_TRUE(h.isInline());
+        h();
+        EXPECT_EQ(future.get(), 42);
+    }
+
+    TEST(InplaceFunctionTest, DestroysCallable)
+    {
+        auto shared = std::make_shared<int>(0);
+        {
+            std::vector<Function> functions;
+            for (int i = 0; i < 100; i++)
+                functions.emplace_back([shared]() { (*shared)++; });
+            EXPECT_EQ(shared.use_count(), 101);
+            for (auto &f : functions)
+                f();
+        }
+        EXPECT_EQ(shared.use_count(), 1);
+        EXPECT_EQ(*shared, 100);
+    }
+} // namespace Thread
@@ -1,13 +1,304 @@
 #include "src/parallel_algo.h"
+#include <climits>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <string>
+
 #include "gtest/gtest.h"
 
 namespace Parallel {
     TEST(SortListTest, Basic) {
         std::list<int> arr{31, 23, 5, 5, 7, 44, 1};
-        SortList<int>(arr);
+        EXPECT_EQ(SortList<int>(arr), (std::list<int>{1, 5, 5, 7, 23, 31, 44}));
+    }
+    TEST(SortListTest, LargeAndPresorted) {
+        std::mt19937 rng(5);
+        std::list<int> arr;
+        for (int i = 0; i < 100000; i++)
+            arr.push_back(rng() % 10000);
+        Thread::v4::ThreadPoolImpl pool(4);
+        pool.start();
+        // the sort splices nodes, addresses of elements stay valid
+        int const *first = &arr.front();
+        int value = arr.front();
+        SortList(pool, arr);
+        EXPECT_EQ(arr.size(), 100000u);
+        EXPECT_TRUE(std::is_sorted(arr.begin(), arr.end()));
+        EXPECT_EQ(*first, value);
+        // sorted input used to be quadratic
+        std::list<int> sorted = SortList(std::move(arr));
+        EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
     }
     TEST(SortVectorTest, Basic) {
         std::vector<int> arr{31, 23, 5, 5, 7, 44, 1};
         SortVector<int>(arr, 0, arr.size() - 1);
+        EXPECT_EQ(arr, (std::vector<int>{1, 5, 5, 7, 23, 31, 44}));
+    }
+    TEST(SortVectorTest, LargeOnPools) {
+        std::mt19937 rng(42);
+        std::vector<int> input(200000);
+        for (auto &x : input)
+            x = rng() % 1000;
+        std::vector<int> expected = input;
+        std::sort(expected.begin(), expected.end());
+
+        Thread::v3::ThreadPoolImpl v3_pool(4);
+        Thread::v4::ThreadPoolImpl v4_pool(4);
+        v3_pool.start();
+        v4_pool.start();
+        std::vector<int> arr = input;
+        SortVector(v3_pool, arr, 0, arr.size() - 1);
+        EXPECT_EQ(arr, expected);
+        // from a worker, the other workers steal the halves it forks
+        arr = input;
+        v3_pool.submit([&]() { SortVector(v3_pool, arr, 0, arr.size() - 1); }).get();
+        EXPECT_EQ(arr, expected);
+        arr = input;
+        SortVector(v4_pool, arr, 0, arr.size() - 1);
+        EXPECT_EQ(arr, expected);
+        // only part of the range
+        arr = input;
+        SortVector(v4_pool, arr, 1000, 150000);
+        EXPECT_TRUE(std::is_sorted(arr.begin() + 1000, arr.begin() + 150001));
+        EXPECT_EQ(arr[0], input[0]);
+        EXPECT_EQ(arr[150001], input[150001]);
+    }
+    TEST(SortVectorTest, AllEqualAndSorted) {
+        std::vector<int> equal(100000, 7);
+        SortVector<int>(equal, 0, equal.size() - 1);
+        EXPECT_TRUE(std::is_sorted(equal.begin(), equal.end()));
+        std::vector<int> descending(100000);
+        for (size_t i = 0; i < descending.size(); i++)
+            descending[i] = descending.size() - i;
+        SortVector<int>(descending, 0, descending.size() - 1);
+        EXPECT_TRUE(std::is_sorted(descending.begin(), descending.end()));
+    }
+    TEST(SortVectorTest, VectorizedTypes) {
+        std::mt19937 rng(11);
+        Thread::v4::ThreadPoolImpl pool(4);
+        pool.start();
+        // few distinct values and the ends of the range as pivots
+        std::vector<int> ints(100000);
+        for (auto &x : ints)
+            x = rng() % 3 == 0 ? INT_MAX : (rng() % 3 == 0 ? INT_MIN : int(rng() % 50));
+        auto expected_ints = ints;
+        std::sort(expected_ints.begin(), expected_ints.end());
+        SortVector(pool, ints, 0, ints.size() - 1);
+        EXPECT_EQ(ints, expected_ints);
+        std::vector<double> doubles(100000);
+        for (auto &x : doubles)
+            x = rng() % 4 == 0 ? std::numeric_limits<double>::infinity() : double(rng() % 100) / 8 - 5;
+        auto expected_doubles = doubles;
+        std::sort(expected_doubles.begin(), expected_doubles.end());
+        SortVector(pool, doubles, 0, doubles.size() - 1);
+        EXPECT_EQ(doubles, expected_doubles);
+        std::vector<float> floats(100000);
+        for (auto &x : floats)
+            x = std::ldexp(float(rng() % 1000), int(rng() % 20) - 10);
+        SortVector(pool, floats, 0, floats.size() - 1);
+        EXPECT_TRUE(std::is_sorted(floats.begin(), floats.end()));
+    }
+    TEST(SortVectorTest, Partition) {
+        std::mt19937 rng(3);
+        std::vector<float> floats(1000);
+        for (auto &x : floats)
+            x = float(rng() % 100);
+        for (int round = 0; round < 10; round++) {
+            int j = Partition(floats, 100, 899);
+            for (int i = 100; i < j; i++)
+                ASSERT_LT(floats[i], floats[j]);
+            for (int i = j; i <= 899; i++)
+                ASSERT_GE(floats[i], floats[j]);
+        }
+        // a single element is its own pivot
+        EXPECT_EQ(Partition(floats, 5, 5), 5);
+    }
+    TEST(RadixSortTest, Integers) {
+        std::mt19937_64 rng(7);
+        std::vector<uint64_t> ids(300000);
+        for (auto &x : ids)
+            x = rng();
+        std::vector<int64_t> times(300000);
+        for (auto &x : times)
+            x = static_cast<int64_t>(rng() % 2000000) - 1000000;
+        std::vector<uint64_t> expected_ids = ids;
+        std::vector<int64_t> expected_times = times;
+        std::sort(expected_ids.begin(), expected_ids.end());
+        std::sort(expected_times.begin(), expected_times.end());
+
+        Thread::v4::ThreadPoolImpl pool(4);
+        pool.start();
+        RadixSort(pool, ids);
+        EXPECT_EQ(ids, expected_ids);
+        RadixSort(times);
+        EXPECT_EQ(times, expected_times);
+
+        std::vector<int> small{31, -23, 5, 5, 7, 44, 1};
+        RadixSort(small);
+        EXPECT_EQ(small, (std::vector<int>{-23, 1, 5, 5, 7, 31, 44}));
+    }
+    TEST(RadixSortTest, StructsByKeyAreStable) {
+        struct Event {
+            uint32_t time_;
+            size_t seq_;
+        };
+        std::mt19937 rng(3);
+        std::vector<Event> events(100000);
+        for (size_t i = 0; i < events.size(); i++)
+            events[i] = {static_cast<uint32_t>(rng() % 5000), i};
+        std::vector<Event> expected = events;
+        std::stable_sort(expected.begin(), expected.end(),
+                         [](Event const &a, Event const &b) { return a.time_ < b.time_; });
+
+        Thread::v3::ThreadPoolImpl pool(4);
+        pool.start();
+        RadixSort(pool, events, [](Event const &e) { return e.time_; });
+        for (size_t i = 0; i < events.size(); i++) {
+            ASSERT_EQ(events[i].time_, expected[i].time_);
+            ASSERT_EQ(events[i].seq_, expected[i].seq_);
+        }
+    }
+    TEST(MergeRunsTest, LoserTreeIsStable) {
+        using Item = std::pair<int, int>;
+        auto by_key = [](Item const &a, Item const &b) { return a.first < b.first; };
+        std::mt19937 rng(9);
+        std::vector<std::vector<Item>> runs(7);
+        std::vector<Item> expected;
+        for (int r = 0; r < 7; r++) {
+            for (int i = 0; i < 1000 + r * 10; i++)
+                runs[r].emplace_back(rng() % 100, r);
+            std::sort(runs[r].begin(), runs[r].end(), by_key);
+            expected.insert(expected.end(), runs[r].begin(), runs[r].end());
+        }
+        // runs are concatenated in order, so a stable sort gives the stable merge
+        std::stable_sort(expected.begin(), expected.end(), by_key);
+        std::vector<std::pair<std::vector<Item>::const_iterator, std::vector<Item>::const_iterator>> ranges;
+        for (auto &run : runs)
+            ranges.emplace_back(run.cbegin(), run.cend());
+        std::vector<Item> merged(expected.size());
+        EXPECT_EQ(MergeRuns(ranges, merged.begin(), by_key), merged.end());
+        EXPECT_EQ(merged, expected);
+
+        Thread::v4::ThreadPoolImpl pool(4);
+        pool.start();
+        std::vector<Item> parallel(expected.size());
+        EXPECT_EQ(MergeRuns(pool, ranges, parallel.begin(), by_key), parallel.end());
+        EXPECT_EQ(parallel, expected);
+    }
+    TEST(MergeRunsTest, ParallelManyRuns) {
+        std::mt19937 rng(11);
+        std::vector<std::vector<uint32_t>> runs(16);
+        std::vector<uint32_t> expected;
+        for (auto &run : runs) {
+            run.resize(rng() % 50000);
+            for (auto &x : run)
+                x = rng();
+            std::sort(run.begin(), run.end());
+            expected.insert(expected.end(), run.begin(), run.end());
+        }
+        runs.emplace_back();
+        std::sort(expected.begin(), expected.end());
+        std::vector<std::pair<uint32_t const *, uint32_t const *>> ranges;
+        for (auto &run : runs)
+            ranges.emplace_back(run.data(), run.data() + run.size());
+        Thread::v3::ThreadPoolImpl pool(4);
+        pool.start();
+        std::vector<uint32_t> merged(expected.size());
+        MergeRuns(pool, ranges, merged.data());
+        EXPECT_EQ(merged, expected);
+    }
+    class AlgorithmTest : public testing::Test {
+    protected:
+        void SetUp() override {
+            pool_.start();
+            data_.resize(100003);
+            std::iota(data_.begin(), data_.end(), 1);
+        }
+        Thread::v4::ThreadPoolImpl pool_{4};
+        std::vector<long> data_;
+    };
+    TEST_F(AlgorithmTest, ForEachAndTransform) {
+        for_each(pool_, data_.begin(), data_.end(), [](long &x) { x *= 2; });
+        std::vector<long> out(data_.size());
+        EXPECT_EQ(transform(pool_, data_.begin(), data_.end(), out.begin(), [](long x) { return x + 1; }),
+                  out.end());
+        for (size_t i = 0; i < data_.size(); i++)
+            ASSERT_EQ(out[i], 2 * long(i + 1) + 1);
+    }
+    TEST_F(AlgorithmTest, Reduce) {
+        long n = data_.size();
+        EXPECT_EQ(reduce(pool_, data_.begin(), data_.end(), 0L), n * (n + 1) / 2);
+        EXPECT_EQ(transform_reduce(pool_, data_.begin(), data_.end(), 0L, std::plus<>(),
+                                   [](long x) { return x % 2; }),
+                  (n + 1) / 2);
+        // not commutative, chunks must be combined in order
+        std::vector<std::string> words(1000);
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] = std::to_string(i % 10);
+        std::string joined = reduce(pool_, words.begin(), words.end(), std::string());
+        EXPECT_EQ(joined, std::accumulate(words.begin(), words.end(), std::string()));
+        EXPECT_EQ(reduce(pool_, data_.begin(), data_.begin(), 5L), 5L);
+    }
+    TEST_F(AlgorithmTest, Scans) {
+        std::vector<long> expected(data_.size());
+        std::inclusive_scan(data_.begin(), data_.end(), expected.begin());
+        std::vector<long> out(data_.size());
+        inclusive_scan(pool_, data_.begin(), data_.end(), out.begin());
+        EXPECT_EQ(out, expected);
+        std::exclusive_scan(data_.begin(), data_.end(), expected.begin(), 10L);
+        // in place
+        exclusive_scan(pool_, data_.begin(), data_.end(), data_.begin(), 10L);
+        EXPECT_EQ(data_, expected);
+    }
+    TEST_F(AlgorithmTest, Grain) {
+        // below two grains the range runs on the calling thread
+        std::vector<std::thread::id> ids(20);
+        for_each(pool_, ids.begin(), ids.end(), [](std::thread::id &id) { id = std::this_thread::get_id(); });
+        for (auto id : ids)
+            ASSERT_EQ(id, std::this_thread::get_id());
+        EXPECT_EQ(detail::chunkCount(pool_, 20, detail::kDefaultGrain), 1u);
+        EXPECT_EQ(detail::chunkCount(pool_, 0, detail::kDefaultGrain), 0u);
+        // no more than eight chunks per pool thread, whatever the grain
+        EXPECT_EQ(detail::chunkCount(pool_, data_.size(), 1), 32u);
+        Thread::v4::ThreadPoolImpl two(2);
+        EXPECT_EQ(detail::chunkCount(two, data_.size(), 1), 16u);
+        EXPECT_EQ(detail::chunkCount(two, 5000, 1000), 5u);
+        std::vector<long> small(20, 1);
+        EXPECT_EQ(reduce(pool_, small.begin(), small.end(), 0L, std::plus<>(), 1), 20L);
+    }
+    TEST_F(AlgorithmTest, VectorizedReduceAndScan) {
+        // whole numbers, so float sums are exact in any order
+        std::vector<int> ints(data_.size());
+        std::vector<float> floats(data_.size());
+        for (size_t i = 0; i < data_.size(); i++) {
+            ints[i] = int(i % 1000) - 500;
+            floats[i] = float(i % 7);
+        }
+        EXPECT_EQ(reduce(pool_, ints.begin(), ints.end(), 3), std::accumulate(ints.begin(), ints.end(), 3));
+        EXPECT_EQ(reduce(pool_, floats.data(), floats.data() + floats.size(), 0.5f),
+                  std::accumulate(floats.begin(), floats.end(), 0.5f));
+        std::vector<int> expected(ints.size());
+        std::inclusive_scan(ints.begin(), ints.end(), expected.begin());
+        inclusive_scan(pool_, ints.begin(), ints.end(), ints.begin());
+        EXPECT_EQ(ints, expected);
+        std::vector<float> expected_floats(floats.size());
+        std::inclusive_scan(floats.begin(), floats.end(), expected_floats.begin());
+        std::vector<float> out(floats.size());
+        inclusive_scan(pool_, floats.begin(), floats.end(), out.begin(), std::plus<float>());
+        EXPECT_EQ(out, expected_floats);
+    }
+    TEST_F(AlgorithmTest, FindIf) {
+        auto it = find_if(pool_, data_.begin(), data_.end(), [](long x) { return x % 7919 == 0; });
+        ASSERT_NE(it, data_.end());
+        EXPECT_EQ(*it, 7919);
+        EXPECT_EQ(find_if(pool_, data_.begin(), data_.end(), [](long x) { return x < 0; }), data_.end());
+        // every chunk past the first match stops early
+        std::atomic<long> calls{0};
+        find_if(pool_, data_.begin(), data_.end(), [&calls](long x) {
+            calls++;
+            return x >= 10;
+        });
+        EXPECT_LT(calls.load(), long(data_.size()));
     }
-};
\ No newline at end of file
+};
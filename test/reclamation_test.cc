@@ -0,0 +1,76 @@
+#include "src/reclamation.h"
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace Container
+{
+    struct Tracked
+    {
+        explicit Tracked(std::atomic<int> &deleted) : deleted_{deleted} {}
+        ~Tracked() { deleted_++; }
+        std::atomic<int> &deleted_;
+    };
+
+    template <typename Reclaimer>
+    class ReclamationTest : public testing::Test
+    {
+    };
+
+    using Reclaimers = testing::Types<HazardPointers, EpochReclamation>;
+    TYPED_TEST_SUITE(ReclamationTest, Reclaimers);
+
+    TYPED_TEST(ReclamationTest, RetiredObjectsAreReclaimed)
+    {
+        std::atomic<int> deleted{0};
+        const int N = 1000;
+        for (int i = 0; i < N; i++)
+            TypeParam::retire(new Tracked(deleted));
+        TypeParam::flush();
+        EXPECT_EQ(deleted.load(), N);
+    }
+
+    TYPED_TEST(ReclamationTest, ProtectedObjectSurvivesRetire)
+    {
+        std::atomic<int> deleted{0};
+        std::atomic<Tracked *> shared{new Tracked(deleted)};
+        std::atomic<bool> protected_flag{false}, retired{false};
+        std::thread reader([&]() {
+            typename TypeParam::Guard guard;
+            Tracked *ptr = guard.protect(0, shared);
+            protected_flag.store(true);
+            while (!retired.load())
+                std::this_thread::yield();
+            // still safe to dereference while the guard is alive
+            EXPECT_EQ(&ptr->deleted_, &deleted);
+        });
+        while (!protected_flag.load())
+            std::this_thread::yield();
+        Tracked *old = shared.exchange(nullptr);
+        TypeParam::retire(old);
+        TypeParam::flush();
+        EXPECT_EQ(deleted.load(), 0);
+        retired.store(true);
+        reader.join();
+        TypeParam::flush();
+        EXPECT_EQ(deleted.load(), 1);
+    }
+
+    struct FreeNode
+    {
+        std::atomic<FreeNode *> next_{nullptr};
+    };
+
+    TEST(FreeListTest, PushPop)
+    {
+        FreeList<FreeNode> free_list;
+        FreeNode nodes[3];
+        for (auto &node : nodes)
+            free_list.push(&node);
+        EXPECT_EQ(free_list.pop(), &nodes[2]);
+        EXPECT_EQ(free_list.pop(), &nodes[1]);
+        EXPECT_EQ(free_list.pop(), &nodes[0]);
+        EXPECT_EQ(free_list.pop(), nullptr);
+    }
+
+} // namespace Container
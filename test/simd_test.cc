@@ -0,0 +1,92 @@
+#include "src/simd.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace Parallel
+{
+namespace Simd
+{
+    // Small whole numbers, so float sums are exact in any order.
+    template <typename T> std::vector<T> randomValues(size_t n, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<T> values(n);
+        for (auto &x : values)
+            x = static_cast<T>(static_cast<int>(rng() % 201) - 100);
+        return values;
+    }
+
+    template <typename T> class SimdTest : public ::testing::Test
+    {
+    };
+
+    using Types = ::testing::Types<int32_t, float, double>;
+    TYPED_TEST_SUITE(SimdTest, Types);
+
+    // every path, a CPU without it runs the next best one
+    Isa const kIsas[] = {Isa::kScalar, Isa::kSse42, Isa::kAvx2};
+    // below one vector, odd tails, several unrolled loops and past the
+    // per thread partition buffer
+    size_t const kSizes[] = {0, 1, 3, 7, 8, 17, 33, 100, 1001, detail::kScratchMax + 1};
+
+    TYPED_TEST(SimdTest, Reduce)
+    {
+        using T = TypeParam;
+        for (Isa isa : kIsas) {
+            for (size_t n : kSizes) {
+                auto values = randomValues<T>(n, static_cast<unsigned>(n));
+                EXPECT_EQ(sum(values.data(), n, isa), std::accumulate(values.begin(), values.end(), T()));
+                if (n == 0)
+                    continue;
+                EXPECT_EQ(min(values.data(), n, isa), *std::min_element(values.begin(), values.end()));
+                EXPECT_EQ(max(values.data(), n, isa), *std::max_element(values.begin(), values.end()));
+            }
+        }
+    }
+
+    TYPED_TEST(SimdTest, InclusiveScan)
+    {
+        using T = TypeParam;
+        for (Isa isa : kIsas) {
+            for (size_t n : kSizes) {
+                auto values = randomValues<T>(n, static_cast<unsigned>(n));
+                std::vector<T> expected(n);
+                std::inclusive_scan(values.begin(), values.end(), expected.begin(), std::plus<>(), T(5));
+                std::vector<T> out(n);
+                inclusiveScan(values.data(), out.data(), n, T(5), isa);
+                EXPECT_EQ(out, expected);
+                // in place
+                inclusiveScan(values.data(), values.data(), n, T(5), isa);
+                EXPECT_EQ(values, expected);
+            }
+        }
+    }
+
+    TYPED_TEST(SimdTest, PartitionIsStable)
+    {
+        using T = TypeParam;
+        for (Isa isa : kIsas) {
+            for (size_t n : kSizes) {
+                auto values = randomValues<T>(n, static_cast<unsigned>(n));
+                auto expected = values;
+                auto mid = std::stable_partition(expected.begin(), expected.end(),
+                                                 [](T x) { return x < T(10); });
+                EXPECT_EQ(partition(values.data(), n, T(10), isa), size_t(mid - expected.begin()));
+                EXPECT_EQ(values, expected);
+            }
+        }
+    }
+
+    TEST(SimdTest, PartitionExtremes)
+    {
+        std::vector<int32_t> values{INT32_MAX, INT32_MIN, 0, -1, 1, INT32_MIN, INT32_MAX, 2, 3};
+        EXPECT_EQ(partition(values.data(), values.size(), INT32_MIN), 0u);
+        EXPECT_EQ(partition(values.data(), values.size(), 0), 3u);
+        EXPECT_EQ(values, (std::vector<int32_t>{INT32_MIN, -1, INT32_MIN, INT32_MAX, 0, 1,
+                                                INT32_MAX, 2, 3}));
+    }
+} // namespace Simd
+} // namespace Parallel
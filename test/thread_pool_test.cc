@@ -1,4 +1,5 @@
 #include "src/thread_pool.h"
+#include <set>
 #include "gtest/gtest.h"
 
 namespace Thread
@@ -22,4 +23,502 @@ namespace Thread
         thread_pool_.shutdown();
         EXPECT_EQ(cnt.load(), N);
     }
-};
\ No newline at end of file
+
+    class WorkStealingThreadPoolTest : public testing::Test
+    {
+    protected:
+        v4::ThreadPoolImpl thread_pool_{4};
+    };
+
+    TEST_F(WorkStealingThreadPoolTest, MultiThreadIncrement)
+    {
+        thread_pool_.start();
+        std::atomic<int> cnt{0};
+        const int N = 10000;
+        for (int i = 0; i < N; i++)
+        {
+            thread_pool_.addTask(
+                [&cnt]() { cnt++; });
+        }
+        thread_pool_.shutdown();
+        EXPECT_EQ(cnt.load(), N);
+    }
+
+    TEST_F(WorkStealingThreadPoolTest, NestedSubmit)
+    {
+        thread_pool_.start();
+        std::atomic<int> cnt{0};
+        const int N = 100;
+        for (int i = 0; i < N; i++)
+        {
+            thread_pool_.addTask([this, &cnt]() {
+                for (int j = 0; j < N; j++)
+                    thread_pool_.addTask([&cnt]() { cnt++; });
+            });
+        }
+        thread_pool_.shutdown();
+        EXPECT_EQ(cnt.load(), N * N);
+    }
+
+    TEST_F(WorkStealingThreadPoolTest, Submit)
+    {
+        thread_pool_.start();
+        Future<int> result = thread_pool_.submit([]() { return 42; });
+        EXPECT_EQ(result.get(), 42);
+    }
+
+    template <typename Pool>
+    long parallelSum(Pool &pool, long begin, long end)
+    {
+        if (end - begin <= 16)
+        {
+            long sum = 0;
+            for (long i = begin; i < end; i++)
+                sum += i;
+            return sum;
+        }
+        long mid = begin + (end - begin) / 2;
+        Future<long> left = pool.submit([&pool, begin, mid]() { return parallelSum(pool, begin, mid); });
+        long right = parallelSum(pool, mid, end);
+        pool.waitUntilReady(left);
+        return left.get() + right;
+    }
+
+    TEST(WaitUntilReadyTest, RecursiveSubmit)
+    {
+        // more nested waits than workers, blocking waits would deadlock
+        v3::ThreadPoolImpl v3_pool(2);
+        v4::ThreadPoolImpl v4_pool(2);
+        v3_pool.start();
+        v4_pool.start();
+        const long N = 4096;
+        Future<long> v3_sum = v3_pool.submit([&v3_pool]() { return parallelSum(v3_pool, 0, N); });
+        Future<long> v4_sum = v4_pool.submit([&v4_pool]() { return parallelSum(v4_pool, 0, N); });
+        EXPECT_EQ(v3_sum.get(), N * (N - 1) / 2);
+        EXPECT_EQ(v4_sum.get(), N * (N - 1) / 2);
+        v3_pool.shutdown();
+        v4_pool.shutdown();
+    }
+
+    TEST(WaitUntilReadyTest, IdleWorkersSteal)
+    {
+        // every part is forked on one worker, the others only get it by stealing
+        v3::ThreadPoolImpl pool(4);
+        pool.start();
+        std::mutex mtx;
+        std::set<std::thread::id> ids;
+        Future<void> root = pool.submit([&]() {
+            std::vector<Future<void>> parts;
+            for (int i = 0; i < 64; i++)
+            {
+                parts.push_back(pool.submit([&]() {
+                    {
+                        std::lock_guard<std::mutex> lck(mtx);
+                        ids.insert(std::this_thread::get_id());
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }));
+            }
+            for (auto &part : parts)
+                pool.waitUntilReady(part);
+        });
+        root.get();
+        pool.shutdown();
+        EXPECT_GT(ids.size(), 1u);
+    }
+
+    TEST(RunOnAllThreadsTest, ReachesEveryWorker)
+    {
+        v3::ThreadPoolImpl pool(4);
+        pool.start();
+        std::mutex mtx;
+        std::set<std::thread::id> ids;
+        std::atomic<int> cnt{0};
+        auto record = [&]() {
+            std::lock_guard<std::mutex> lck(mtx);
+            ids.insert(std::this_thread::get_id());
+            cnt++;
+        };
+        EXPECT_TRUE(pool.runOnAllThreads(record));
+        // a worker broadcasting gets its own copy too
+        Future<void> inner = pool.submit([&pool, &record]() { EXPECT_TRUE(pool.runOnAllThreads(record)); });
+        inner.get();
+        pool.shutdown();
+        EXPECT_EQ(cnt.load(), 8);
+        EXPECT_EQ(ids.size(), 4u);
+    }
+
+    TEST(RunOnAllThreadsTest, WorkersBroadcastToEachOther)
+    {
+        // far more copies than a worker runs while it broadcasts itself
+        v3::ThreadPoolImpl pool(4);
+        pool.start();
+        std::atomic<int> cnt{0};
+        std::vector<Future<void>> broadcasts;
+        for (int i = 0; i < 4; i++)
+        {
+            broadcasts.push_back(pool.submit([&pool, &cnt]() {
+                for (int j = 0; j < 1000; j++)
+                    pool.runOnAllThreads([&cnt]() { cnt++; });
+            }));
+        }
+        for (auto &broadcast : broadcasts)
+            broadcast.get();
+        pool.shutdown();
+        EXPECT_EQ(cnt.load(), 4 * 1000 * 4);
+    }
+
+    TEST(RunOnAllThreadsTest, RejectedUnlessRunning)
+    {
+        v3::ThreadPoolImpl pool(2);
+        std::atomic<int> cnt{0};
+        EXPECT_FALSE(pool.runOnAllThreads([&cnt]() { cnt++; }));
+        pool.start();
+        EXPECT_TRUE(pool.runOnAllThreads([&cnt]() { cnt++; }));
+        pool.shutdown();
+        EXPECT_FALSE(pool.runOnAllThreads([&cnt]() { cnt++; }));
+        EXPECT_EQ(cnt.load(), 2);
+    }
+
+    TEST(ScheduleTest, DelayedAndPeriodic)
+    {
+        v1::ThreadPoolImpl v1_pool(2);
+        v2::ThreadPoolImpl v2_pool(2);
+        v3::ThreadPoolImpl v3_pool(2);
+        v4::ThreadPoolImpl v4_pool(2);
+        std::vector<ThreadPool *> pools{&v1_pool, &v2_pool, &v3_pool, &v4_pool};
+        for (ThreadPool *pool : pools)
+        {
+            pool->start();
+            std::atomic<int> once{0}, periodic{0}, cancelled{0};
+            auto start = ThreadPool::Clock::now();
+            pool->scheduleAfter(std::chrono::milliseconds(10), [&once, start]() {
+                EXPECT_GE(ThreadPool::Clock::now() - start, std::chrono::milliseconds(10));
+                once++;
+            });
+            ThreadPool::TimerId every = pool->scheduleEvery(std::chrono::milliseconds(5), [&periodic]() { periodic++; });
+            ThreadPool::TimerId never = pool->scheduleAt(start + std::chrono::milliseconds(20), [&cancelled]() { cancelled++; });
+            EXPECT_TRUE(pool->cancelTimer(never));
+            std::this_thread::sleep_for(std::chrono::milliseconds(60));
+            EXPECT_TRUE(pool->cancelTimer(every));
+            EXPECT_EQ(once.load(), 1);
+            EXPECT_GE(periodic.load(), 3);
+            EXPECT_EQ(cancelled.load(), 0);
+            pool->shutdown();
+            EXPECT_FALSE(pool->scheduleAfter(std::chrono::milliseconds(1), []() {}).valid());
+        }
+    }
+
+    class PriorityThreadPoolTest : public testing::Test
+    {
+    protected:
+        // one worker, held by a blocking task while the test queues work
+        void block()
+        {
+            thread_pool_.start();
+            thread_pool_.addTask(0, [this]() {
+                while (!release_.load())
+                    std::this_thread::yield();
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+
+        v5::ThreadPoolImpl thread_pool_{1, {3, 1}};
+        std::atomic<bool> release_{false};
+        std::mutex mtx_;
+        std::vector<int> order_;
+    };
+
+    TEST_F(PriorityThreadPoolTest, WeightedClasses)
+    {
+        block();
+        for (int i = 0; i < 8; i++)
+        {
+            thread_pool_.addTask(1, [this]() { std::lock_guard<std::mutex> lck(mtx_); order_.push_back(1); });
+            thread_pool_.addTask(0, [this]() { std::lock_guard<std::mutex> lck(mtx_); order_.push_back(0); });
+        }
+        EXPECT_EQ(thread_pool_.stats(0).depth_, 8);
+        EXPECT_EQ(thread_pool_.stats(1).depth_, 8);
+        release_.store(true);
+        thread_pool_.shutdown();
+        // three urgent tasks for every background one while both have work,
+        // the blocking task used the first urgent credit
+        std::vector<int> expected{0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1};
+        EXPECT_EQ(order_, expected);
+        EXPECT_EQ(thread_pool_.stats(0).depth_, 0);
+        EXPECT_EQ(thread_pool_.stats(0).executed_, 9);
+        EXPECT_EQ(thread_pool_.stats(1).executed_, 8);
+    }
+
+    TEST_F(PriorityThreadPoolTest, EarliestDeadlineFirst)
+    {
+        block();
+        auto now = ThreadPool::Clock::now();
+        for (int i = 0; i < 4; i++)
+        {
+            thread_pool_.addTask(1, now + std::chrono::seconds(10 - i), [this, i]() {
+                std::lock_guard<std::mutex> lck(mtx_);
+                order_.push_back(i);
+            });
+        }
+        thread_pool_.addTask(1, [this]() { std::lock_guard<std::mutex> lck(mtx_); order_.push_back(-1); });
+        thread_pool_.addTask(1, now - std::chrono::seconds(1), [this]() { std::lock_guard<std::mutex> lck(mtx_); order_.push_back(4); });
+        release_.store(true);
+        thread_pool_.shutdown();
+        EXPECT_EQ(order_, (std::vector<int>{4, 3, 2, 1, 0, -1}));
+        EXPECT_EQ(thread_pool_.stats(1).late_, 1);
+    }
+
+    TEST(IdlePolicyTest, ParkedWorkersWakeUp)
+    {
+        IdlePolicy park_immediately{0, 0, true};
+        v2::ThreadPoolImpl v2_pool(2, park_immediately);
+        v3::ThreadPoolImpl v3_pool(2, park_immediately);
+        v4::ThreadPoolImpl v4_pool(2, park_immediately);
+        std::vector<ThreadPool *> pools{&v2_pool, &v3_pool, &v4_pool};
+        for (ThreadPool *pool : pools)
+        {
+            pool->start();
+            // give every worker time to park before work shows up
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::atomic<int> cnt{0};
+            const int N = 1000;
+            for (int i = 0; i < N; i++)
+                pool->addTask([&cnt]() { cnt++; });
+            // the tasks must run without shutdown() waking everybody up
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (cnt.load() < N && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::yield();
+            EXPECT_EQ(cnt.load(), N);
+            pool->shutdown();
+        }
+    }
+
+    TEST(NumaThreadPoolTest, SubmitOnNode)
+    {
+        // two nominal nodes, unpinned so it runs on any machine
+        Topology topology({{0, 2}, {1, 3}});
+        v4::ThreadPoolImpl pool(4, IdlePolicy{}, false, topology);
+        pool.start();
+        std::vector<Future<int>> results;
+        for (int i = 0; i < 100; i++)
+            results.push_back(pool.submitOnNode(i % 2, [i]() { return i; }));
+        for (int i = 0; i < 100; i++)
+            EXPECT_EQ(results[i].get(), i);
+        pool.shutdown();
+    }
+
+    TEST(NumaThreadPoolTest, PinnedWorkers)
+    {
+        v4::ThreadPoolImpl pool(2, IdlePolicy{}, true);
+        pool.start();
+        std::atomic<int> cnt{0};
+        for (int i = 0; i < 100; i++)
+            pool.addTask([&cnt]() { cnt++; });
+        pool.shutdown();
+        EXPECT_EQ(cnt.load(), 100);
+    }
+
+    TEST(ElasticThreadPoolTest, CompensatesBlockedWorkers)
+    {
+        v6::ThreadPoolImpl pool(1, 4, std::chrono::seconds(10),
+                                std::chrono::seconds(10));
+        pool.start();
+        // every task blocks until all four run at once
+        std::atomic<int> started{0};
+        std::vector<Future<void>> results;
+        for (int i = 0; i < 4; i++)
+        {
+            results.push_back(pool.submit([&started]() {
+                v6::ScopedBlocking blocking;
+                started++;
+                while (started.load() < 4)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }));
+        }
+        for (auto &result : results)
+            result.get();
+        EXPECT_EQ(pool.threads(), 4u);
+    }
+
+    TEST(ElasticThreadPoolTest, GrowsOnLatencyAndRetires)
+    {
+        v6::ThreadPoolImpl pool(1, 2, std::chrono::milliseconds(20),
+                                std::chrono::milliseconds(5));
+        pool.start();
+        std::atomic<bool> release{false};
+        Future<void> busy = pool.submit([&release]() {
+            while (!release.load())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+        // runs on a second worker while the first one is still busy
+        Future<int> queued = pool.submit([]() { return 7; });
+        EXPECT_EQ(queued.get(), 7);
+        EXPECT_EQ(pool.threads(), 2u);
+        release.store(true);
+        busy.get();
+        for (int i = 0; i < 100 && pool.threads() > 1; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        EXPECT_EQ(pool.threads(), 1u);
+    }
+
+    class LifecycleTest : public testing::Test
+    {
+    protected:
+        LifecycleTest()
+        {
+            pools_.emplace_back(new ThreadPoolImpl(1));
+            pools_.emplace_back(new v2::ThreadPoolImpl(1));
+            pools_.emplace_back(new v3::ThreadPoolImpl(1));
+            pools_.emplace_back(new v4::ThreadPoolImpl(1));
+            pools_.emplace_back(new v5::ThreadPoolImpl(1));
+            pools_.emplace_back(new v6::ThreadPoolImpl(1, 1));
+        }
+
+        // occupies the only worker until the pool is cancelled
+        static void block(ThreadPool &pool)
+        {
+            std::atomic<bool> started{false};
+            CancellationToken token = pool.cancellationToken();
+            pool.addTask([&started, token]() {
+                started.store(true);
+                while (!token.isCancelled())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            });
+            while (!started.load())
+                std::this_thread::yield();
+        }
+
+        std::vector<std::unique_ptr<ThreadPool>> pools_;
+    };
+
+    TEST_F(LifecycleTest, DrainRunsQueuedTasks)
+    {
+        for (auto &pool : pools_)
+        {
+            pool->start();
+            std::atomic<int> cnt{0};
+            for (int i = 0; i < 100; i++)
+                pool->addTask([&cnt]() { cnt++; });
+            EXPECT_TRUE(pool->drain(std::chrono::seconds(10)));
+            EXPECT_EQ(cnt.load(), 100);
+            EXPECT_FALSE(pool->addTask([]() {}));
+        }
+    }
+
+    TEST_F(LifecycleTest, ShutdownNowReturnsQueuedTasks)
+    {
+        for (auto &pool : pools_)
+        {
+            pool->start();
+            block(*pool);
+            std::atomic<int> cnt{0};
+            for (int i = 0; i < 10; i++)
+                pool->addTask([&cnt]() { cnt++; });
+            // the blocked worker cannot finish in time
+            EXPECT_FALSE(pool->drain(std::chrono::milliseconds(20)));
+            EXPECT_FALSE(pool->addTask([&cnt]() { cnt++; }));
+            std::vector<Task> pending = pool->shutdownNow();
+            EXPECT_TRUE(pool->cancellationToken().isCancelled());
+            EXPECT_EQ(cnt.load(), 0);
+            ASSERT_EQ(pending.size(), 10u);
+            for (auto &task : pending)
+                task();
+            EXPECT_EQ(cnt.load(), 10);
+        }
+    }
+
+    TEST_F(LifecycleTest, WorkersOfCancelledPoolAreCounted)
+    {
+        for (auto &pool : pools_)
+        {
+            pool->shutdownNow();
+            // the workers see the cancelled token and exit at once, maybe
+            // before start() returns
+            pool->start();
+            auto begin = std::chrono::steady_clock::now();
+            EXPECT_TRUE(pool->drain(std::chrono::seconds(10)));
+            EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(5));
+        }
+    }
+
+    // Posts from several threads while the pool shuts down, every task the
+    // pool accepted has to run.
+    template <typename Pool> void raceAddTaskAgainstShutdown()
+    {
+        for (int round = 0; round < 50; round++)
+        {
+            Pool pool(2);
+            pool.start();
+            std::atomic<int> accepted{0};
+            std::atomic<int> ran{0};
+            std::vector<std::thread> posters;
+            for (int i = 0; i < 3; i++)
+            {
+                posters.emplace_back([&pool, &accepted, &ran]() {
+                    while (pool.addTask([&ran]() { ran++; }))
+                        accepted++;
+                });
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50 * (round % 10)));
+            pool.shutdown();
+            for (auto &poster : posters)
+                poster.join();
+            EXPECT_EQ(ran.load(), accepted.load());
+        }
+    }
+
+    TEST(ShutdownRaceTest, AcceptedTasksRun)
+    {
+        raceAddTaskAgainstShutdown<v2::ThreadPoolImpl>();
+        raceAddTaskAgainstShutdown<v3::ThreadPoolImpl>();
+        raceAddTaskAgainstShutdown<v4::ThreadPoolImpl>();
+        raceAddTaskAgainstShutdown<v2::BasicThreadPoolImpl<Container::LockFreeStack>>();
+    }
+
+    TEST(BoundedTaskQueueTest, Backpressure)
+    {
+        v2::BasicThreadPoolImpl<Container::BoundedQueue> pool(1, IdlePolicy{}, 4);
+        pool.start();
+        std::atomic<bool> release{false};
+        std::atomic<int> cnt{0};
+        EXPECT_TRUE(pool.addTask([&]() {
+            while (!release.load())
+                std::this_thread::yield();
+        }));
+        // wait for the worker to pick up the blocking task
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        int accepted = 0;
+        for (int i = 0; i < 10; i++)
+            accepted += pool.addTask([&cnt]() { cnt++; });
+        EXPECT_EQ(accepted, 4);
+        release.store(true);
+        pool.shutdown();
+        EXPECT_EQ(cnt.load(), 4);
+    }
+
+    TEST(BoundedTaskQueueTest, Submit)
+    {
+        v3::BasicThreadPoolImpl<Container::BoundedQueue> pool(2, IdlePolicy{}, 16);
+        pool.start();
+        Future<int> result = pool.submit([]() { return 7; });
+        EXPECT_EQ(result.get(), 7);
+    }
+
+    TEST(LockFreeTaskQueueTest, MultiThreadIncrement)
+    {
+        v2::BasicThreadPoolImpl<Container::LockFreeStack> v2_pool(4);
+        v3::BasicThreadPoolImpl<Container::LockFreeStack> v3_pool(4);
+        std::vector<ThreadPool *> pools{&v2_pool, &v3_pool};
+        for (ThreadPool *pool : pools)
+        {
+            pool->start();
+            std::atomic<int> cnt{0};
+            const int N = 1000;
+            for (int i = 0; i < N; i++)
+                pool->addTask([&cnt]() { cnt++; });
+            pool->shutdown();
+            EXPECT_EQ(cnt.load(), N);
+        }
+    }
+};
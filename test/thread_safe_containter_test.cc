@@ -115,4 +115,566 @@ namespace Container
         EXPECT_TRUE(stk_.empty());
     }
 
+    class WorkStealingDequeTest : public testing::Test
+    {
+    public:
+        WorkStealingDeque<int> deque_{4};
+    };
+
+    TEST_F(WorkStealingDequeTest, OwnerLastInFirstOut)
+    {
+        int N = 100;
+        for (int i = 0; i < N; i++)
+            deque_.push(i);
+        EXPECT_EQ(deque_.size(), N);
+        int temp;
+        for (int i = N - 1; i >= 0; i--)
+        {
+            EXPECT_TRUE(deque_.pop(temp));
+            EXPECT_EQ(temp, i);
+        }
+        EXPECT_FALSE(deque_.pop(temp));
+        EXPECT_TRUE(deque_.empty());
+    }
+
+    TEST_F(WorkStealingDequeTest, ThiefFirstInFirstOut)
+    {
+        int N = 100;
+        for (int i = 0; i < N; i++)
+            deque_.push(i);
+        int temp;
+        for (int i = 0; i < N; i++)
+        {
+            EXPECT_TRUE(deque_.steal(temp));
+            EXPECT_EQ(temp, i);
+        }
+        EXPECT_FALSE(deque_.steal(temp));
+    }
+
+    TEST_F(WorkStealingDequeTest, ConcurrentSteal)
+    {
+        const int N = 100000;
+        std::atomic<long long> sum{0};
+        std::atomic<bool> done{false};
+        std::vector<std::thread> thieves;
+        for (int t = 0; t < 3; t++)
+        {
+            thieves.emplace_back([&]() {
+                int temp;
+                while (!done.load() || !deque_.empty())
+                {
+                    if (deque_.steal(temp))
+                        sum += temp;
+                }
+            });
+        }
+        int temp;
+        for (int i = 1; i <= N; i++)
+        {
+            deque_.push(i);
+            if (i % 3 == 0 && deque_.pop(temp))
+                sum += temp;
+        }
+        while (deque_.pop(temp))
+            sum += temp;
+        done.store(true);
+        for (auto &thief : thieves)
+            thief.join();
+        EXPECT_EQ(sum.load(), 1LL * N * (N + 1) / 2);
+    }
+
+    class BoundedQueueTest : public testing::Test
+    {
+    public:
+        BoundedQueue<int> q_{64};
+    };
+
+    TEST_F(BoundedQueueTest, FirstInFirstOut)
+    {
+        EXPECT_EQ(q_.capacity(), 64);
+        for (int i = 0; i < 64; i++)
+            EXPECT_TRUE(q_.try_push(i));
+        EXPECT_FALSE(q_.try_push(64));
+        int temp;
+        for (int i = 0; i < 64; i++)
+        {
+            EXPECT_TRUE(q_.try_pop(temp));
+            EXPECT_EQ(temp, i);
+        }
+        EXPECT_FALSE(q_.try_pop(temp));
+        EXPECT_TRUE(q_.empty());
+    }
+
+    TEST_F(BoundedQueueTest, Bulk)
+    {
+        std::vector<int> in(100);
+        for (int i = 0; i < 100; i++)
+            in[i] = i;
+        EXPECT_EQ(q_.push_bulk(in.begin(), in.end()), 64);
+        std::vector<int> out;
+        EXPECT_EQ(q_.pop_bulk(std::back_inserter(out), 10), 10);
+        EXPECT_EQ(q_.pop_bulk(std::back_inserter(out), 100), 54);
+        for (int i = 0; i < 64; i++)
+            EXPECT_EQ(out[i], i);
+        EXPECT_TRUE(q_.empty());
+    }
+
+    TEST_F(BoundedQueueTest, MultiProducerMultiConsumer)
+    {
+        const int N = 20000;
+        std::atomic<long long> sum{0};
+        std::atomic<int> popped{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; t++)
+        {
+            threads.emplace_back([&, t]() {
+                for (int i = t; i < N; i += 2)
+                    q_.push(i);
+            });
+            threads.emplace_back([&]() {
+                int temp;
+                while (popped.load() < N)
+                {
+                    if (q_.try_pop(temp))
+                    {
+                        sum += temp;
+                        popped++;
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        EXPECT_EQ(sum.load(), 1LL * N * (N - 1) / 2);
+    }
+
+    TEST(BoundedQueueOwnershipTest, DestroysLeftovers)
+    {
+        auto value = std::make_shared<int>(1);
+        {
+            BoundedQueue<std::shared_ptr<int>> q(8);
+            q.push(value);
+            q.push(value);
+            EXPECT_EQ(value.use_count(), 3);
+        }
+        EXPECT_EQ(value.use_count(), 1);
+    }
+
+    template <typename Reclaimer>
+    class LockFreeQueueTest : public testing::Test
+    {
+    public:
+        LockFreeQueue<int, Reclaimer> q_;
+    };
+
+    using Reclaimers = testing::Types<HazardPointers, EpochReclamation>;
+    TYPED_TEST_SUITE(LockFreeQueueTest, Reclaimers);
+
+    TYPED_TEST(LockFreeQueueTest, FirstInFirstOut)
+    {
+        int N = 100;
+        for (int i = 0; i < N; i++)
+            this->q_.push(i);
+        int temp;
+        for (int i = 0; i < N; i++)
+        {
+            EXPECT_TRUE(this->q_.try_pop(temp));
+            EXPECT_EQ(temp, i);
+        }
+        EXPECT_FALSE(this->q_.try_pop(temp));
+        EXPECT_TRUE(this->q_.empty());
+    }
+
+    TYPED_TEST(LockFreeQueueTest, MultiProducerMultiConsumer)
+    {
+        const int N = 20000;
+        std::atomic<long long> sum{0};
+        std::atomic<int> popped{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; t++)
+        {
+            threads.emplace_back([&, t]() {
+                for (int i = t; i < N; i += 2)
+                    this->q_.push(i);
+            });
+            threads.emplace_back([&]() {
+                int temp;
+                while (popped.load() < N)
+                {
+                    if (this->q_.try_pop(temp))
+                    {
+                        sum += temp;
+                        popped++;
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        EXPECT_EQ(sum.load(), 1LL * N * (N - 1) / 2);
+        EXPECT_TRUE(this->q_.empty());
+    }
+
+    TEST(LockFreeQueueOwnershipTest, DestroysLeftovers)
+    {
+        auto value = std::make_shared<int>(1);
+        {
+            LockFreeQueue<std::shared_ptr<int>> q;
+            q.push(value);
+            q.push(value);
+            std::shared_ptr<int> temp;
+            EXPECT_TRUE(q.try_pop(temp));
+            temp.reset();
+            EXPECT_EQ(value.use_count(), 2);
+        }
+        EXPECT_EQ(value.use_count(), 1);
+    }
+
+    TEST(LockFreeQueueOwnershipTest, RecyclesAfterDestruction)
+    {
+        {
+            LockFreeQueue<int, EpochReclamation> q;
+            int temp;
+            for (int i = 0; i < 1000; i++)
+            {
+                q.push(i);
+                EXPECT_TRUE(q.try_pop(temp));
+            }
+        }
+        // the popped nodes reach the queue's free-list only now
+        EpochReclamation::flush();
+    }
+
+    class LockFreeStackTest : public testing::Test
+    {
+    public:
+        LockFreeStack<int> stk_;
+    };
+
+    TEST_F(LockFreeStackTest, FirstInLastOut)
+    {
+        int N = 100;
+        for (int i = 0; i < N; i++)
+            stk_.push(i);
+        int temp;
+        for (int i = N - 1; i >= 0; i--)
+        {
+            EXPECT_TRUE(stk_.try_pop(temp));
+            EXPECT_EQ(temp, i);
+        }
+        EXPECT_FALSE(stk_.try_pop(temp));
+        EXPECT_TRUE(stk_.empty());
+    }
+
+    TEST_F(LockFreeStackTest, PushRangePopAll)
+    {
+        std::vector<int> in{1, 2, 3, 4};
+        stk_.push(0);
+        stk_.push_range(in.begin(), in.end());
+        std::vector<int> out;
+        EXPECT_EQ(stk_.pop_all(std::back_inserter(out)), 5);
+        EXPECT_EQ(out, (std::vector<int>{4, 3, 2, 1, 0}));
+        EXPECT_TRUE(stk_.empty());
+    }
+
+    TEST_F(LockFreeStackTest, ConcurrentPushPop)
+    {
+        const int N = 20000;
+        std::atomic<long long> sum{0};
+        std::atomic<int> popped{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; t++)
+        {
+            threads.emplace_back([&, t]() {
+                for (int i = t; i < N; i += 2)
+                    stk_.push(i);
+            });
+            threads.emplace_back([&]() {
+                int temp;
+                while (popped.load() < N)
+                {
+                    if (stk_.try_pop(temp))
+                    {
+                        sum += temp;
+                        popped++;
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        EXPECT_EQ(sum.load(), 1LL * N * (N - 1) / 2);
+    }
+
+    class ConcurrentHashMapTest : public testing::Test
+    {
+    public:
+        ConcurrentHashMap<int, std::string> map_;
+    };
+
+    TEST_F(ConcurrentHashMapTest, PutGetErase)
+    {
+        const int N = 10000;
+        for (int i = 0; i < N; i++)
+            EXPECT_TRUE(map_.put(i, std::to_string(i)));
+        EXPECT_FALSE(map_.put(7, "seven"));
+        EXPECT_EQ(map_.size(), N);
+        EXPECT_EQ(map_.get(7), std::optional<std::string>("seven"));
+        for (int i = 0; i < N; i += 2)
+            EXPECT_TRUE(map_.erase(i));
+        EXPECT_FALSE(map_.erase(0));
+        EXPECT_EQ(map_.size(), N / 2);
+        for (int i = 0; i < N; i++)
+        {
+            if (i % 2 == 0)
+            {
+                EXPECT_FALSE(map_.get(i).has_value());
+            }
+            else if (i != 7)
+            {
+                EXPECT_EQ(map_.get(i), std::optional<std::string>(std::to_string(i)));
+            }
+        }
+        map_.clear();
+        EXPECT_EQ(map_.size(), 0);
+        EXPECT_FALSE(map_.contains(1));
+    }
+
+    TEST_F(ConcurrentHashMapTest, ChurnReusesTombstones)
+    {
+        for (int round = 0; round < 50; round++)
+        {
+            for (int i = 0; i < 1000; i++)
+                map_.put(round * 1000 + i, "x");
+            for (int i = 0; i < 1000; i++)
+                EXPECT_TRUE(map_.erase(round * 1000 + i));
+        }
+        EXPECT_EQ(map_.size(), 0);
+    }
+
+    TEST_F(ConcurrentHashMapTest, MultiThreadPut)
+    {
+        const int N = 20000;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&, t]() {
+                for (int i = t; i < N; i += 4)
+                {
+                    map_.put(i, std::to_string(i));
+                    EXPECT_TRUE(map_.contains(i));
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        EXPECT_EQ(map_.size(), N);
+    }
+
+    class ThreadSafeHashMapTest : public testing::Test
+    {
+    public:
+        ThreadSafeHashMap<int, int> map_;
+    };
+
+    TEST_F(ThreadSafeHashMapTest, GrowIncrementally)
+    {
+        const int N = 5000;
+        bool migrated = false;
+        for (int i = 0; i < N; i++)
+        {
+            map_.put(i, i + 1);
+            migrated |= map_.migrating();
+            // every key stays visible while buckets move between tables
+            EXPECT_EQ(map_.get(i / 2), i / 2 + 1);
+        }
+        EXPECT_TRUE(migrated);
+        EXPECT_EQ(map_.size(), N);
+        for (int i = 0; i < N; i++)
+            EXPECT_EQ(map_.get(i), i + 1);
+        for (int i = 0; i < N; i++)
+            map_.erase(i);
+        EXPECT_EQ(map_.size(), 0);
+        EXPECT_FALSE(map_.get(1).has_value());
+    }
+
+    TEST_F(ThreadSafeHashMapTest, ExplicitResize)
+    {
+        for (int i = 0; i < 100; i++)
+            map_.put(i, i);
+        map_.resize(7);
+        EXPECT_FALSE(map_.migrating());
+        EXPECT_EQ(map_.bucket_count(), 7);
+        for (int i = 0; i < 100; i++)
+            EXPECT_EQ(map_.get(i), i);
+        map_.clear();
+        EXPECT_EQ(map_.size(), 0);
+    }
+
+    TEST_F(ThreadSafeHashMapTest, ConcurrentResize)
+    {
+        for (int i = 0; i < 1000; i++)
+            map_.put(i, i);
+        // resizes that lose the race to link their table retry after it
+        std::vector<std::thread> threads;
+        for (size_t buckets : {31, 67, 131})
+        {
+            threads.emplace_back([&, buckets]() {
+                for (int round = 0; round < 50; round++)
+                    map_.resize(buckets);
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        EXPECT_FALSE(map_.migrating());
+        size_t buckets = map_.bucket_count();
+        EXPECT_TRUE(buckets == 31 || buckets == 67 || buckets == 131);
+        for (int i = 0; i < 1000; i++)
+            EXPECT_EQ(map_.get(i), i);
+        map_.resize(53);
+        EXPECT_EQ(map_.bucket_count(), 53);
+    }
+
+    TEST_F(ThreadSafeHashMapTest, ReadersDuringGrowth)
+    {
+        const int N = 20000;
+        std::atomic<bool> done{false};
+        std::atomic<int> misses{0};
+        map_.put(0, -1);
+        std::thread writer([&]() {
+            for (int i = 1; i < N; i++)
+                map_.put(i, i);
+            done.store(true);
+        });
+        std::thread reader([&]() {
+            while (!done.load())
+            {
+                // key 0 never changes, so it must always be found
+                if (map_.get(0) != -1)
+                    misses++;
+            }
+        });
+        writer.join();
+        reader.join();
+        EXPECT_EQ(map_.size(), N);
+        EXPECT_EQ(misses.load(), 0);
+    }
+
+    TEST(ThreadSafeHashMapReadTest, ReadsSeeMonotonicUpdates)
+    {
+        ThreadSafeHashMap<int, std::string> map;
+        const int N = 20000;
+        map.put(0, std::to_string(0));
+        std::atomic<bool> done{false};
+        std::atomic<int> regressions{0};
+        std::thread reader([&]() {
+            int last = 0;
+            while (!done.load())
+            {
+                std::optional<std::string> value = map.get(0);
+                ASSERT_TRUE(value.has_value());
+                int current = std::stoi(*value);
+                if (current < last)
+                    regressions++;
+                last = current;
+                EXPECT_FALSE(map.get(-1).has_value());
+            }
+        });
+        for (int i = 1; i < N; i++)
+        {
+            map.put(0, std::to_string(i));
+            map.put(i, std::to_string(i));
+        }
+        done.store(true);
+        reader.join();
+        EXPECT_EQ(regressions.load(), 0);
+        EXPECT_EQ(map.get(0), std::optional<std::string>(std::to_string(N - 1)));
+    }
+
+    TEST_F(ThreadSafeHashMapTest, MultiPutGetErase)
+    {
+        std::vector<std::pair<int, int>> kvs;
+        std::vector<int> keys;
+        for (int i = 0; i < 500; i++)
+        {
+            kvs.emplace_back(i, i * 2);
+            keys.push_back(i);
+        }
+        map_.multi_put(kvs);
+        EXPECT_EQ(map_.size(), 500);
+        keys.push_back(-1);
+        std::vector<std::optional<int>> values = map_.multi_get(keys);
+        ASSERT_EQ(values.size(), 501);
+        for (int i = 0; i < 500; i++)
+            EXPECT_EQ(values[i], i * 2);
+        EXPECT_FALSE(values[500].has_value());
+        keys.resize(250);
+        map_.multi_erase(keys);
+        EXPECT_EQ(map_.size(), 250);
+        EXPECT_FALSE(map_.get(0).has_value());
+        EXPECT_EQ(map_.get(499), 998);
+    }
+
+    TEST_F(ThreadSafeHashMapTest, ShardedForEach)
+    {
+        const int N = 3000;
+        for (int i = 0; i < N; i++)
+            map_.put(i, i);
+        std::vector<std::thread> threads;
+        std::atomic<long long> sum{0};
+        std::atomic<int> cnt{0};
+        {
+            auto scan = map_.scan();
+            for (size_t shard = 0; shard < 3; shard++)
+            {
+                threads.emplace_back([&, shard]() {
+                    map_.for_each(scan, [&](int const &, int const &value) {
+                        sum += value;
+                        cnt++;
+                    }, shard, 3);
+                });
+            }
+            for (auto &thread : threads)
+                thread.join();
+        }
+        EXPECT_EQ(cnt.load(), N);
+        EXPECT_EQ(sum.load(), 1LL * N * (N - 1) / 2);
+        EXPECT_EQ(map_.snapshot().size(), N);
+    }
+
+    TEST_F(ThreadSafeHashMapTest, ShardedForEachDuringGrowth)
+    {
+        const int N = 3000;
+        for (int i = 0; i < N; i++)
+            map_.put(i, i);
+        std::vector<std::atomic<int>> visits(N);
+        std::atomic<bool> done{false};
+        // keeps the map growing while the shards run
+        std::thread writer([&]() {
+            for (int i = N; !done.load(); i++)
+                map_.put(i, i);
+        });
+        for (int round = 0; round < 20; round++)
+        {
+            auto scan = map_.scan();
+            std::vector<std::thread> shards;
+            for (size_t shard = 0; shard < 3; shard++)
+            {
+                shards.emplace_back([&, shard]() {
+                    map_.for_each(scan, [&](int const &key, int const &) {
+                        if (key < N)
+                            visits[key]++;
+                    }, shard, 3);
+                });
+            }
+            for (auto &shard : shards)
+                shard.join();
+        }
+        done.store(true);
+        writer.join();
+        for (int i = 0; i < N; i++)
+            EXPECT_EQ(visits[i].load(), 20);
+        EXPECT_EQ(map_.get(N - 1), N - 1);
+    }
+
 } // namespace
@@ -0,0 +1,129 @@
+#include "src/timer_wheel.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace Thread
+{
+    using namespace std::chrono_literals;
+
+    TEST(TimerWheelTest, FiresInDeadlineOrder)
+    {
+        TimerWheel wheel(1ms);
+        std::mutex mtx;
+        std::vector<int> fired;
+        auto start = TimerWheel::Clock::now();
+        // 100ms is more than a full turn of the lowest level
+        for (int delay : {100, 5, 20, 1})
+        {
+            wheel.schedule(start + std::chrono::milliseconds(delay), [&, delay]() {
+                std::lock_guard<std::mutex> lck(mtx);
+                fired.push_back(delay);
+                EXPECT_GE(TimerWheel::Clock::now() - start, std::chrono::milliseconds(delay));
+            });
+        }
+        auto deadline = start + 5s;
+        while (wheel.size() > 0 && TimerWheel::Clock::now() < deadline)
+            std::this_thread::sleep_for(1ms);
+        std::lock_guard<std::mutex> lck(mtx);
+        EXPECT_EQ(fired, (std::vector<int>{1, 5, 20, 100}));
+    }
+
+    TEST(TimerWheelTest, IdleWheelCatchesUp)
+    {
+        TimerWheel wheel(1ms);
+        std::this_thread::sleep_for(30ms);
+        std::atomic<bool> fired{false};
+        auto start = TimerWheel::Clock::now();
+        wheel.schedule(2ms, [&fired]() { fired.store(true); });
+        while (!fired.load() && TimerWheel::Clock::now() - start < 5s)
+            std::this_thread::sleep_for(1ms);
+        EXPECT_TRUE(fired.load());
+        EXPECT_LT(TimerWheel::Clock::now() - start, 1s);
+    }
+
+    TEST(TimerWheelTest, StopDropsPendingTimers)
+    {
+        TimerWheel wheel;
+        std::atomic<int> fired{0};
+        wheel.schedule(1h, [&fired]() { fired++; });
+        EXPECT_EQ(wheel.size(), 1);
+        wheel.stop();
+        EXPECT_EQ(wheel.size(), 0);
+        EXPECT_FALSE(wheel.schedule(1ms, [&fired]() { fired++; }).valid());
+        EXPECT_EQ(fired.load(), 0);
+    }
+    TEST(TimerWheelTest, StopFromCallback)
+    {
+        TimerWheel wheel(1ms);
+        std::atomic<bool> stopped{false};
+        auto id = wheel.schedule(1h, []() {});
+        wheel.schedule(1ms, [&]() {
+            wheel.stop();
+            stopped = true;
+        });
+        // cancel() and size() race the stop
+        while (!stopped)
+        {
+            wheel.cancel(id);
+            wheel.size();
+        }
+        EXPECT_EQ(wheel.size(), 0);
+        EXPECT_FALSE(wheel.cancel(id));
+        wheel.stop();
+    }
+    TEST(TimerWheelTest, Cancel)
+    {
+        TimerWheel wheel(1ms);
+        std::atomic<int> fired{0};
+        TimerWheel::TimerId first = wheel.schedule(10ms, [&fired]() { fired++; });
+        TimerWheel::TimerId far = wheel.schedule(10s, [&fired]() { fired++; });
+        wheel.schedule(20ms, [&fired]() { fired += 10; });
+        EXPECT_TRUE(wheel.cancel(first));
+        EXPECT_FALSE(wheel.cancel(first));
+        EXPECT_TRUE(wheel.cancel(far));
+        std::this_thread::sleep_for(100ms);
+        EXPECT_EQ(fired.load(), 10);
+        EXPECT_EQ(wheel.size(), 0);
+        // the slot of first may be reused, its id must stay dead
+        wheel.schedule(1h, []() {});
+        EXPECT_FALSE(wheel.cancel(first));
+    }
+
+    TEST(TimerWheelTest, Periodic)
+    {
+        TimerWheel wheel(1ms);
+        std::atomic<int> fired{0};
+        TimerWheel::TimerId id = wheel.scheduleEvery(5ms, [&fired]() { fired++; });
+        std::this_thread::sleep_for(100ms);
+        EXPECT_TRUE(wheel.cancel(id));
+        int count = fired.load();
+        EXPECT_GE(count, 5);
+        EXPECT_LE(count, 21);
+        std::this_thread::sleep_for(30ms);
+        EXPECT_EQ(fired.load(), count);
+        EXPECT_EQ(wheel.size(), 0);
+    }
+
+    TEST(TimerWheelTest, ManyTimers)
+    {
+        TimerWheel wheel(1ms);
+        std::atomic<int> fired{0};
+        const int N = 10000;
+        std::vector<TimerWheel::TimerId> ids;
+        for (int i = 0; i < N; i++)
+            ids.push_back(wheel.schedule(std::chrono::milliseconds(i % 300), [&fired]() { fired++; }));
+        // cancel every other timer
+        int cancelled = 0;
+        for (int i = 0; i < N; i += 2)
+            cancelled += wheel.cancel(ids[i]);
+        auto deadline = TimerWheel::Clock::now() + 5s;
+        while (fired.load() + cancelled < N && TimerWheel::Clock::now() < deadline)
+            std::this_thread::sleep_for(1ms);
+        EXPECT_EQ(fired.load() + cancelled, N);
+        EXPECT_EQ(wheel.size(), 0);
+    }
+} // namespace Thread
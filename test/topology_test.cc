@@ -0,0 +1,35 @@
+#include "src/topology.h"
+
+#include "gtest/gtest.h"
+
+namespace Thread
+{
+    TEST(TopologyTest, ParseCpuList)
+    {
+        EXPECT_EQ(Topology::parseCpuList("0-3,8,10-11\n"),
+                  (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+        EXPECT_EQ(Topology::parseCpuList("5"), std::vector<int>{5});
+        EXPECT_TRUE(Topology::parseCpuList("").empty());
+    }
+
+    TEST(TopologyTest, ExplicitNodes)
+    {
+        // the empty node is dropped, the others numbered densely
+        Topology topology({{4, 5, 6}, {}, {0, 1}});
+        EXPECT_EQ(topology.nodes(), 2u);
+        EXPECT_EQ(topology.nodeOf(5), 0u);
+        EXPECT_EQ(topology.nodeOf(1), 1u);
+        EXPECT_EQ(topology.nodeOf(42), 0u);
+        EXPECT_EQ(topology.cpus(), (std::vector<int>{4, 5, 6, 0, 1}));
+        EXPECT_EQ(topology.interleaved(), (std::vector<int>{4, 0, 5, 1, 6}));
+    }
+
+    TEST(TopologyTest, System)
+    {
+        Topology const &topology = Topology::system();
+        ASSERT_GE(topology.nodes(), 1u);
+        EXPECT_FALSE(topology.cpus().empty());
+        EXPECT_LT(topology.currentNode(), topology.nodes());
+        EXPECT_TRUE(Topology::pinCurrentThread(topology.cpus().front()));
+    }
+};